@@ -1,14 +1,17 @@
 #include "AssetStore.h"
+#include "../Jobs/JobSystem.h"
 #include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
+#include "../Memory/MemoryTracker.h"
 #include "SDL_image.h"
 
-AssetStore::AssetStore() {
-	Logger::Log("Asset store constructor called!");
+AssetStore::AssetStore(JobSystem* jobSystem) : jobSystem(jobSystem) {
+	LOG_INFO(LogCategory::Assets, "Asset store constructor called!");
 }
 
 AssetStore::~AssetStore() {
 	ClearAssets();
-	Logger::Log("Asset store destructor called");
+	LOG_INFO(LogCategory::Assets, "Asset store destructor called");
 }
 
 void AssetStore::ClearAssets() {
@@ -17,14 +20,52 @@ void AssetStore::ClearAssets() {
 	}
 
 	textures.clear();
+	MemoryTracker::Free(MemoryTag::Textures, textureMemory);
+	textureMemory = 0;
 }
 void AssetStore::AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath) {
-	SDL_Surface* surface = IMG_Load(filePath.c_str());
+	PROFILE_SCOPE("AssetStore::AddTexture");
+
+	AddTextureFromSurface(renderer, assetId, IMG_Load(filePath.c_str()));
+}
+
+void AssetStore::AddTextures(SDL_Renderer* renderer, const std::vector<std::pair<std::string, std::string>>& textureFiles) {
+	PROFILE_SCOPE("AssetStore::AddTextures");
+
+	// Decoding is most of the load time and only touches the file and its surface
+	std::vector<SDL_Surface*> surfaces(textureFiles.size(), nullptr);
+	auto decode = [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			surfaces[i] = IMG_Load(textureFiles[i].second.c_str());
+		}
+	};
+
+	if (jobSystem) {
+		jobSystem->ParallelFor(static_cast<int>(textureFiles.size()), 1, decode);
+	} else {
+		decode(0, static_cast<int>(textureFiles.size()));
+	}
+
+	for (size_t i = 0; i < textureFiles.size(); i++) {
+		AddTextureFromSurface(renderer, textureFiles[i].first, surfaces[i]);
+	}
+}
+
+void AssetStore::AddTextureFromSurface(SDL_Renderer* renderer, const std::string& assetId, SDL_Surface* surface) {
 	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
 	SDL_FreeSurface(surface);
 
+	Uint32 format;
+	int width;
+	int height;
+	if (texture && SDL_QueryTexture(texture, &format, nullptr, &width, &height) == 0) {
+		const size_t bytes = static_cast<size_t>(width) * height * SDL_BYTESPERPIXEL(format);
+		MemoryTracker::Allocate(MemoryTag::Textures, bytes);
+		textureMemory += bytes;
+	}
+
 	textures.emplace(assetId, texture);
-	Logger::Log("New texture added to asset store. AssetId: " + assetId);
+	LOG_INFO(LogCategory::Assets, "New texture added to asset store. AssetId: {}", assetId);
 }
 
 
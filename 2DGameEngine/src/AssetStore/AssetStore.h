@@ -3,20 +3,36 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <utility>
 #include <SDL.h>
 
+class JobSystem;
+
 class AssetStore {
 private:
 	std::map<std::string, SDL_Texture*> textures;
+	// Estimated from width * height * bytes per pixel, the driver may use more
+	size_t textureMemory = 0;
+	// Decodes images in parallel when set
+	JobSystem* jobSystem;
 	 // TODO: create a map for fonts
 	// TODO: create a map for audio
+
+	void AddTextureFromSurface(SDL_Renderer* renderer, const std::string& assetId, SDL_Surface* surface);
 public:
-	AssetStore();
+	AssetStore(JobSystem* jobSystem = nullptr);
 	~AssetStore();
 
 	void ClearAssets();
 	void AddTexture(SDL_Renderer* renderer, const std::string& assetId, const std::string& filePath);
+	// Same as calling AddTexture for every (assetId, filePath) pair, but the files are decoded on the job system.
+	// The textures are still created on the calling thread, the renderer isn't thread safe
+	void AddTextures(SDL_Renderer* renderer, const std::vector<std::pair<std::string, std::string>>& textureFiles);
 	SDL_Texture* GetTexture(const std::string& assetId); 
+
+	int GetNumTextures() const { return static_cast<int>(textures.size()); }
+	size_t GetTextureMemory() const { return textureMemory; }
 };
 
 #endif
\ No newline at end of file
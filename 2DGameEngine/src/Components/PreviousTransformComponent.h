@@ -0,0 +1,22 @@
+#ifndef PREVIOUSTRANSFORMCOMPONENT_H
+#define PREVIOUSTRANSFORMCOMPONENT_H
+
+#include "glm/glm.hpp"
+#include "TransformComponent.h"
+
+// The TransformComponent as it was before the last simulation step.
+// Entities that move get one so the RenderSystem can draw them between two steps
+// instead of snapping from step to step when the frame rate isn't the tick rate
+struct PreviousTransformComponent {
+	glm::vec2 position;
+	glm::vec2 scale;
+	double rotation;
+
+	PreviousTransformComponent(const TransformComponent& transform = TransformComponent()) {
+		this->position = transform.position;
+		this->scale = transform.scale;
+		this->rotation = transform.rotation;
+	}
+};
+
+#endif
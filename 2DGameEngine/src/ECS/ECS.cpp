@@ -1,63 +1,733 @@
+#include <algorithm>
 #include <vector>
+#include <atomic>
+#include <cstdlib>
 #include "ECS.h"
 #include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
 
-int IComponent::nextId = 0;
+#if defined(__AVX2__) && !defined(ECS_NO_SIMD)
+#include <immintrin.h>
+#elif (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(ECS_NO_SIMD)
+#include <emmintrin.h>
+#endif
+
+int IComponent::NextId() {
+	// Component types can be seen for the first time from any thread
+	static std::atomic<int> nextId(0);
+
+	const int id = nextId++;
+	if (id >= static_cast<int>(MAX_COMPONENTS)) {
+		LOG_ERR(LogCategory::ECS, "Too many component types, the limit is {}. Build with a larger ECS_MAX_COMPONENTS", MAX_COMPONENTS);
+		std::abort();
+	}
+	return id;
+}
+
+// The vector loops of MatchSignatures, returns how many signatures they covered.
+// A template on the signature width so only the branch for the configured width is compiled,
+// the others declare arrays that would be zero sized
+template <int NUM_WORDS>
+static int MatchSignaturesVectorized(const uint64_t* words, int count, const Signature& mask, uint8_t* results) {
+	int i = 0;
+
+#if defined(__AVX2__) && !defined(ECS_NO_SIMD)
+	if constexpr (NUM_WORDS == 1) {
+		// Four signatures per register
+		const __m256i maskVector = _mm256_set1_epi64x(static_cast<long long>(mask.GetWord(0)));
+		for (; i + 4 <= count; i += 4) {
+			const __m256i signatureVector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+			const __m256i matches = _mm256_cmpeq_epi64(_mm256_and_si256(signatureVector, maskVector), maskVector);
+			const int bits = _mm256_movemask_pd(_mm256_castsi256_pd(matches));
+			results[i] = bits & 1;
+			results[i + 1] = (bits >> 1) & 1;
+			results[i + 2] = (bits >> 2) & 1;
+			results[i + 3] = (bits >> 3) & 1;
+		}
+	} else if constexpr (NUM_WORDS == 2) {
+		// Two signatures per register
+		const __m256i maskVector = _mm256_setr_epi64x(
+			static_cast<long long>(mask.GetWord(0)), static_cast<long long>(mask.GetWord(1)),
+			static_cast<long long>(mask.GetWord(0)), static_cast<long long>(mask.GetWord(1)));
+		for (; i + 2 <= count; i += 2) {
+			const __m256i signatureVector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i * 2));
+			const __m256i matches = _mm256_cmpeq_epi64(_mm256_and_si256(signatureVector, maskVector), maskVector);
+			const int bits = _mm256_movemask_pd(_mm256_castsi256_pd(matches));
+			results[i] = (bits & 0x3) == 0x3;
+			results[i + 1] = (bits & 0xC) == 0xC;
+		}
+	} else {
+		// One or more registers per signature, testc checks (~signature & mask) == 0
+		__m256i maskWords[NUM_WORDS / 4];
+		for (int word = 0; word < NUM_WORDS / 4; word++) {
+			maskWords[word] = _mm256_setr_epi64x(
+				static_cast<long long>(mask.GetWord(word * 4)), static_cast<long long>(mask.GetWord(word * 4 + 1)),
+				static_cast<long long>(mask.GetWord(word * 4 + 2)), static_cast<long long>(mask.GetWord(word * 4 + 3)));
+		}
+		for (; i < count; i++) {
+			int match = 1;
+			for (int word = 0; word < NUM_WORDS / 4; word++) {
+				const __m256i signatureVector = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i * NUM_WORDS + word * 4));
+				match &= _mm256_testc_si256(signatureVector, maskWords[word]);
+			}
+			results[i] = static_cast<uint8_t>(match);
+		}
+	}
+#elif (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(ECS_NO_SIMD)
+	// SSE2 has no 64 bit compare, compare 32 bit halves instead: a 64 bit word matches when both halves do
+	if constexpr (NUM_WORDS == 1) {
+		const __m128i maskVector = _mm_set1_epi64x(static_cast<long long>(mask.GetWord(0)));
+		for (; i + 2 <= count; i += 2) {
+			const __m128i signatureVector = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+			const __m128i matches = _mm_cmpeq_epi32(_mm_and_si128(signatureVector, maskVector), maskVector);
+			const int bits = _mm_movemask_epi8(matches);
+			results[i] = (bits & 0x00FF) == 0x00FF;
+			results[i + 1] = (bits & 0xFF00) == 0xFF00;
+		}
+	} else {
+		__m128i maskWords[NUM_WORDS / 2];
+		for (int word = 0; word < NUM_WORDS / 2; word++) {
+			maskWords[word] = _mm_set_epi64x(static_cast<long long>(mask.GetWord(word * 2 + 1)), static_cast<long long>(mask.GetWord(word * 2)));
+		}
+		for (; i < count; i++) {
+			int bits = 0xFFFF;
+			for (int word = 0; word < NUM_WORDS / 2; word++) {
+				const __m128i signatureVector = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i * NUM_WORDS + word * 2));
+				bits &= _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(signatureVector, maskWords[word]), maskWords[word]));
+			}
+			results[i] = bits == 0xFFFF;
+		}
+	}
+#else
+	// Scalar build, the loop in MatchSignatures does everything
+	(void)words;
+	(void)count;
+	(void)mask;
+	(void)results;
+#endif
+
+	return i;
+}
+
+void MatchSignatures(const Signature* signatures, int count, const Signature& mask, uint8_t* results) {
+	int i = MatchSignaturesVectorized<Signature::NUM_WORDS>(reinterpret_cast<const uint64_t*>(signatures), count, mask, results);
+
+	// Whatever the vector loops didn't cover
+	for (; i < count; i++) {
+		results[i] = (signatures[i] & mask) == mask;
+	}
+}
+
+std::string GetDisplayTypeName(const char* typeName) {
+	std::string name(typeName);
+	for (const char* prefix : { "class ", "struct " }) {
+		const size_t length = std::char_traits<char>::length(prefix);
+		if (name.compare(0, length, prefix) == 0) {
+			return name.substr(length);
+		}
+	}
+	return name;
+}
+
+thread_local uint64_t CommandBuffer::threadSortKey = 0;
+
+static std::atomic<uint64_t> nextRegistrySerial(1);
+
+// The payload starts right after the header, aligned for any component
+static constexpr size_t COMMAND_PAYLOAD_OFFSET =
+	(sizeof(CommandBuffer::CommandHeader) + CommandBuffer::COMMAND_ALIGNMENT - 1) / CommandBuffer::COMMAND_ALIGNMENT * CommandBuffer::COMMAND_ALIGNMENT;
+
+void* CommandBuffer::CommandHeader::GetPayload() {
+	return reinterpret_cast<unsigned char*>(this) + COMMAND_PAYLOAD_OFFSET;
+}
+
+CommandBuffer::~CommandBuffer() {
+	Clear();
+}
+
+CommandBuffer::CommandHeader* CommandBuffer::Allocate(CommandType type, size_t payloadSize) {
+	const size_t size = (COMMAND_PAYLOAD_OFFSET + payloadSize + COMMAND_ALIGNMENT - 1) / COMMAND_ALIGNMENT * COMMAND_ALIGNMENT;
+
+	// Move on to the next block when the command doesn't fit, blocks from earlier frames are reused
+	while (currentBlock < static_cast<int>(blocks.size()) && blocks[currentBlock].used + size > blocks[currentBlock].capacity) {
+		currentBlock++;
+	}
+
+	if (currentBlock == static_cast<int>(blocks.size())) {
+		Block block;
+		block.capacity = std::max(BLOCK_SIZE, size);
+		block.bytes = std::make_unique<unsigned char[]>(block.capacity);
+		blocks.push_back(std::move(block));
+	}
+
+	auto& block = blocks[currentBlock];
+	auto* command = new (block.bytes.get() + block.used) CommandHeader();
+	block.used += size;
+
+	command->type = type;
+	command->size = static_cast<uint32_t>(size);
+	command->sequence = numCommands++;
+	command->sortKey = threadSortKey;
+	return command;
+}
+
+Entity CommandBuffer::ResolveTarget(const CommandHeader& command) const {
+	return command.deferredIndex >= 0 ? createdEntities[command.deferredIndex] : command.entity;
+}
+
+DeferredEntity CommandBuffer::CreateEntity() {
+	CommandHeader* command = Allocate(CommandType::CreateEntity, 0);
+	command->deferredIndex = numDeferredEntities++;
+	return DeferredEntity{ command->deferredIndex };
+}
+
+void CommandBuffer::KillEntity(Entity entity) {
+	CommandHeader* command = Allocate(CommandType::KillEntity, 0);
+	command->entity = entity;
+}
+
+void CommandBuffer::Clear() {
+	// Payloads that were applied have been moved from but still need to be destroyed
+	ForEachCommand([](CommandHeader& command) {
+		if (command.destroy) {
+			command.destroy(command.GetPayload());
+		}
+	});
+
+	for (auto& block : blocks) {
+		block.used = 0;
+	}
+
+	currentBlock = 0;
+	numCommands = 0;
+	numDeferredEntities = 0;
+	createdEntities.clear();
+}
+
+ArchetypeStorage::~ArchetypeStorage() {
+	// Chunks are raw memory so the components living in them have to be destroyed by hand
+	for (auto& archetype : archetypes) {
+		for (int chunk = 0; chunk < static_cast<int>(archetype->chunks.size()); chunk++) {
+			for (int index = 0; index < archetype->chunks[chunk].count; index++) {
+				for (int column = 0; column < static_cast<int>(archetype->componentIds.size()); column++) {
+					archetype->columnTypes[column]->destroy(archetype->GetComponent(column, chunk, index));
+				}
+			}
+		}
+	}
+}
+
+Archetype* ArchetypeStorage::GetOrCreateArchetype(const Signature& signature) {
+	auto existing = archetypesBySignature.find(signature);
+	if (existing != archetypesBySignature.end()) {
+		return existing->second;
+	}
+
+	auto archetype = std::make_unique<Archetype>();
+	archetype->signature = signature;
+	std::fill(std::begin(archetype->columnIndices), std::end(archetype->columnIndices), -1);
+
+	size_t bytesPerEntity = sizeof(int);
+	for (int componentId = 0; componentId < static_cast<int>(MAX_COMPONENTS); componentId++) {
+		if (!signature.test(componentId)) {
+			continue;
+		}
+		archetype->columnIndices[componentId] = static_cast<int>(archetype->componentIds.size());
+		archetype->componentIds.push_back(componentId);
+		archetype->columnTypes.push_back(componentTypes[componentId]);
+		bytesPerEntity += componentTypes[componentId]->size;
+	}
+	archetype->columnOffsets.resize(archetype->componentIds.size());
+
+	// Lay the columns out back to back for a given capacity and return the bytes used
+	auto layoutColumns = [&archetype](int capacity) {
+		size_t offset = 0;
+		for (size_t column = 0; column < archetype->columnTypes.size(); column++) {
+			const auto alignment = archetype->columnTypes[column]->alignment;
+			offset = (offset + alignment - 1) / alignment * alignment;
+			archetype->columnOffsets[column] = offset;
+			offset += archetype->columnTypes[column]->size * capacity;
+		}
+		offset = (offset + alignof(int) - 1) / alignof(int) * alignof(int);
+		archetype->entityIdsOffset = offset;
+		return offset + sizeof(int) * capacity;
+	};
+
+	// Start from the estimate without padding and shrink until the padded layout fits
+	int capacity = std::max(1, static_cast<int>(ARCHETYPE_CHUNK_SIZE / bytesPerEntity));
+	while (capacity > 1 && layoutColumns(capacity) > ARCHETYPE_CHUNK_SIZE) {
+		capacity--;
+	}
+	const size_t chunkBytesUsed = layoutColumns(capacity);
+	assert(chunkBytesUsed <= ARCHETYPE_CHUNK_SIZE && "Components of this archetype do not fit in one chunk");
+	(void)chunkBytesUsed;
+	archetype->chunkCapacity = capacity;
+
+	Archetype* result = archetype.get();
+	archetypes.push_back(std::move(archetype));
+	archetypesBySignature.emplace(signature, result);
+
+	LOG_DEBUG(LogCategory::ECS, "Archetype created with {} components and {} entities per chunk", result->componentIds.size(), capacity);
+
+	return result;
+}
+
+ArchetypeStorage::EntityLocation ArchetypeStorage::MoveEntity(int entityId, const Signature& newSignature) {
+	if (entityId >= static_cast<int>(entityLocations.size())) {
+		entityLocations.resize(entityId + 1);
+	}
+
+	const EntityLocation oldLocation = entityLocations[entityId];
+	Archetype* newArchetype = GetOrCreateArchetype(newSignature);
+
+	// New entities always go at the end of the last chunk
+	if (newArchetype->chunks.empty() || newArchetype->chunks.back().count == newArchetype->chunkCapacity) {
+		newArchetype->chunks.emplace_back();
+	}
+
+	EntityLocation newLocation;
+	newLocation.archetype = newArchetype;
+	newLocation.chunk = static_cast<int>(newArchetype->chunks.size()) - 1;
+	newLocation.index = newArchetype->chunks.back().count;
+
+	newArchetype->chunks.back().count++;
+	newArchetype->numEntities++;
+	newArchetype->GetEntityIds(newLocation.chunk)[newLocation.index] = entityId;
+
+	if (oldLocation.archetype) {
+		Archetype* oldArchetype = oldLocation.archetype;
+
+		for (int column = 0; column < static_cast<int>(oldArchetype->componentIds.size()); column++) {
+			const auto* type = oldArchetype->columnTypes[column];
+			const int newColumn = newArchetype->columnIndices[oldArchetype->componentIds[column]];
+			void* source = oldArchetype->GetComponent(column, oldLocation.chunk, oldLocation.index);
+
+			if (newColumn != -1) {
+				type->moveConstruct(newArchetype->GetComponent(newColumn, newLocation.chunk, newLocation.index), source);
+			}
+			type->destroy(source);
+		}
+
+		RemoveFromArchetype(oldLocation, false);
+	}
+
+	entityLocations[entityId] = newLocation;
+	return newLocation;
+}
+
+void ArchetypeStorage::RemoveFromArchetype(const EntityLocation& location, bool destroyComponents) {
+	Archetype* archetype = location.archetype;
+	const int numColumns = static_cast<int>(archetype->componentIds.size());
+
+	if (destroyComponents) {
+		for (int column = 0; column < numColumns; column++) {
+			archetype->columnTypes[column]->destroy(archetype->GetComponent(column, location.chunk, location.index));
+		}
+	}
+
+	// Swap and pop: move the last entity of the archetype into the hole so chunks stay packed
+	const int lastChunk = static_cast<int>(archetype->chunks.size()) - 1;
+	const int lastIndex = archetype->chunks[lastChunk].count - 1;
+
+	if (lastChunk != location.chunk || lastIndex != location.index) {
+		for (int column = 0; column < numColumns; column++) {
+			const auto* type = archetype->columnTypes[column];
+			void* last = archetype->GetComponent(column, lastChunk, lastIndex);
+			type->moveConstruct(archetype->GetComponent(column, location.chunk, location.index), last);
+			type->destroy(last);
+		}
+
+		const int movedEntityId = archetype->GetEntityIds(lastChunk)[lastIndex];
+		archetype->GetEntityIds(location.chunk)[location.index] = movedEntityId;
+		entityLocations[movedEntityId].chunk = location.chunk;
+		entityLocations[movedEntityId].index = location.index;
+	}
+
+	archetype->chunks[lastChunk].count--;
+	archetype->numEntities--;
+
+	if (archetype->chunks[lastChunk].count == 0) {
+		archetype->chunks.pop_back();
+	}
+}
+
+bool ArchetypeStorage::HasComponent(int entityId, int componentId) const {
+	return entityId < static_cast<int>(entityLocations.size()) &&
+		entityLocations[entityId].archetype &&
+		entityLocations[entityId].archetype->signature.test(componentId);
+}
+
+void ArchetypeStorage::RemoveEntity(int entityId) {
+	if (entityId >= static_cast<int>(entityLocations.size()) || !entityLocations[entityId].archetype) {
+		return;
+	}
+
+	RemoveFromArchetype(entityLocations[entityId], true);
+	entityLocations[entityId] = EntityLocation();
+}
+
+void ArchetypeStorage::GetStats(std::vector<StorageStats>& stats) const {
+	for (const auto& archetype : archetypes) {
+		StorageStats archetypeStats;
+		archetypeStats.name = "Archetype";
+		archetypeStats.itemSize = sizeof(int);
+		for (int column = 0; column < static_cast<int>(archetype->componentIds.size()); column++) {
+			archetypeStats.name += ' ' + std::to_string(archetype->componentIds[column]);
+			archetypeStats.itemSize += archetype->columnTypes[column]->size;
+		}
+		archetypeStats.size = archetype->numEntities;
+		archetypeStats.capacity = static_cast<int>(archetype->chunks.size()) * archetype->chunkCapacity;
+		stats.push_back(std::move(archetypeStats));
+	}
+}
 
 void System::AddEntityToSystem(Entity entity) {
+	const auto entityId = entity.GetId();
+
+	if (entityId >= static_cast<int>(entityIdToSlot.size())) {
+		entityIdToSlot.resize(entityId + 1, -1);
+	}
+
+	if (entityIdToSlot[entityId] != -1) {
+		return;
+	}
+
+	entityIdToSlot[entityId] = static_cast<int>(entities.size());
 	entities.push_back(entity);
+	membershipVersion++;
 }
 
 void System::RemoveEntityFromSystem(Entity entity) {
-	entities.erase(std::remove_if(entities.begin(), entities.end(), [&entity](Entity other) {
-		return entity == other;
-	}), entities.end());
-	
+	if (!HasEntity(entity)) {
+		return;
+	}
+
+	// Swap and pop: the last entity takes the removed entity's slot
+	const auto entityId = entity.GetId();
+	const int slot = entityIdToSlot[entityId];
+	const Entity last = entities.back();
+
+	entities[slot] = last;
+	entityIdToSlot[last.GetId()] = slot;
+
+	entities.pop_back();
+	entityIdToSlot[entityId] = -1;
+	membershipVersion++;
+}
+
+bool System::HasEntity(Entity entity) const {
+	const auto entityId = entity.GetId();
+	return entityId < static_cast<int>(entityIdToSlot.size()) &&
+		entityIdToSlot[entityId] != -1 &&
+		entities[entityIdToSlot[entityId]] == entity;
+}
+
+bool System::ConflictsWith(const System& other) const {
+	return (writeSignature & (other.readSignature | other.writeSignature)).any() ||
+		(other.writeSignature & readSignature).any();
+}
+
+void Entity::Kill() {
+	registry->KillEntity(*this);
+}
+
+Registry::Registry(StorageMode storageMode) : storageMode(storageMode), serial(nextRegistrySerial++) {
+	LOG_INFO(LogCategory::ECS, "Registry created!");
+}
+
+Registry::~Registry() {
+	LOG_INFO(LogCategory::ECS, "Registry destroyed!");
+}
+
+CommandBuffer& Registry::GetCommandBuffer() {
+	// Per thread cache of the buffers this thread uses, almost always a single registry.
+	// Only the first call from a thread takes the lock
+	struct CachedCommandBuffer {
+		uint64_t registrySerial;
+		CommandBuffer* buffer;
+	};
+	static thread_local std::vector<CachedCommandBuffer> cachedCommandBuffers;
+
+	for (const auto& cached : cachedCommandBuffers) {
+		if (cached.registrySerial == serial) {
+			return *cached.buffer;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(commandBuffersMutex);
+	commandBuffers.push_back(std::make_unique<CommandBuffer>());
+	cachedCommandBuffers.push_back({ serial, commandBuffers.back().get() });
+	return *commandBuffers.back();
+}
+
+void Registry::PlaybackCommandBuffers() {
+	// Nobody records while Update runs, the lock only keeps out threads creating a new buffer
+	std::lock_guard<std::mutex> lock(commandBuffersMutex);
+
+	playbackCommands.clear();
+	for (int buffer = 0; buffer < static_cast<int>(commandBuffers.size()); buffer++) {
+		auto& commandBuffer = *commandBuffers[buffer];
+		commandBuffer.createdEntities.assign(commandBuffer.numDeferredEntities, Entity(0));
+		commandBuffer.ForEachCommand([this, buffer](CommandBuffer::CommandHeader& command) {
+			playbackCommands.push_back({ command.sortKey, command.sequence, buffer, &command });
+		});
+	}
+
+	if (playbackCommands.empty()) {
+		return;
+	}
+
+	// Same order every run, whichever threads recorded the commands
+	std::sort(playbackCommands.begin(), playbackCommands.end(), [](const PlaybackCommand& a, const PlaybackCommand& b) {
+		if (a.sortKey != b.sortKey) return a.sortKey < b.sortKey;
+		if (a.buffer != b.buffer) return a.buffer < b.buffer;
+		return a.sequence < b.sequence;
+	});
+
+	for (const auto& playbackCommand : playbackCommands) {
+		auto& command = *playbackCommand.command;
+		auto& commandBuffer = *commandBuffers[playbackCommand.buffer];
+
+		switch (command.type) {
+		case CommandBuffer::CommandType::CreateEntity:
+			commandBuffer.createdEntities[command.deferredIndex] = CreateEntity();
+			break;
+		case CommandBuffer::CommandType::KillEntity:
+			KillEntity(command.entity);
+			break;
+		case CommandBuffer::CommandType::AddComponent:
+		case CommandBuffer::CommandType::RemoveComponent: {
+			// The target could have been killed before the buffer was played back
+			const Entity target = commandBuffer.ResolveTarget(command);
+			if (IsAlive(target)) {
+				command.apply(*this, target, command.GetPayload());
+			}
+			break;
+		}
+		}
+	}
+
+	for (auto& commandBuffer : commandBuffers) {
+		commandBuffer->Clear();
+	}
 }
 
 Entity Registry::CreateEntity() {
-	int entityId = numEntities++;
+	int entityId;
+
+	if (freeIds.empty()) {
+		// No ids to reuse, grow the per entity arrays
+		entityId = numEntities++;
+		if (entityId >= static_cast<int>(entityComponentSignatures.size())) {
+			entityComponentSignatures.resize(entityId + 1);
+			entityGenerations.resize(entityId + 1, 0);
+			entityNeedsRematch.resize(entityId + 1, false);
+		}
+	} else {
+		// Reuse the id of a killed entity, its generation was already bumped when it was killed
+		entityId = freeIds.front();
+		freeIds.pop_front();
+	}
 
-	Entity entity(entityId);
+	Entity entity(entityId, entityGenerations[entityId]);
 	entity.registry = this;
 
-	entitiesToBeAdded.insert(entity);
+	// New entities are matched with the systems in the next Update
+	QueueRematch(entityId);
 
-	if (entityId >= entityComponentSignatures.size()) {
-		entityComponentSignatures.resize(entityId + 1);
+	LOG_DEBUG(LogCategory::ECS, "Entity created with id = {}", entityId);
+
+	return entity;
+}
+
+void Registry::CreateEntitiesInto(int count, std::vector<Entity>& entities) {
+	if (count <= 0) {
+		return;
 	}
 
-	Logger::Log("Entity created with id = " + std::to_string(entityId));
+	const size_t firstCreated = entities.size();
+	entities.reserve(firstCreated + count);
 
-	return entity;
+	// Killed ids first, same order CreateEntity would use them in
+	const int numReused = std::min(count, static_cast<int>(freeIds.size()));
+	for (int i = 0; i < numReused; i++) {
+		const int entityId = freeIds.front();
+		freeIds.pop_front();
+		entities.emplace_back(entityId, entityGenerations[entityId]);
+	}
+
+	// Grow the per entity arrays once for the rest
+	const int firstNewId = numEntities;
+	numEntities += count - numReused;
+	if (numEntities > static_cast<int>(entityComponentSignatures.size())) {
+		entityComponentSignatures.resize(numEntities);
+		entityGenerations.resize(numEntities, 0);
+		entityNeedsRematch.resize(numEntities, false);
+	}
+	for (int entityId = firstNewId; entityId < numEntities; entityId++) {
+		entities.emplace_back(entityId, entityGenerations[entityId]);
+	}
+
+	entitiesToBeRematched.reserve(entitiesToBeRematched.size() + count);
+	for (size_t i = firstCreated; i < entities.size(); i++) {
+		entities[i].registry = this;
+		QueueRematch(entities[i].GetId());
+	}
+
+	LOG_DEBUG(LogCategory::ECS, "{} entities created", count);
+}
+
+void Registry::KillEntity(Entity entity) {
+	if (!IsAlive(entity)) {
+		return;
+	}
+
+	entitiesToBeKilled.push_back(entity);
+}
+
+bool Registry::IsAlive(Entity entity) const {
+	const auto entityId = entity.GetId();
+	return entityId < static_cast<int>(entityGenerations.size()) &&
+		entityGenerations[entityId] == entity.GetGeneration();
 }
 
 void Registry::Update() {
-	// TODO: Add the entities that are waiting to be created to the active systems
-	// TODO: Remove the entities that are waiting to be created to the active systems
-	for (auto entity : entitiesToBeAdded) {
-		AddEntityToSystems(entity);
+	PROFILE_SCOPE("Registry::Update");
+
+	// Apply the structural changes recorded by systems since the last update
+	PlaybackCommandBuffers();
+
+	// Match the entities that were created or whose signature changed with the active systems
+	MatchRematchedEntities();
+
+	// Remove the entities that are waiting to be killed from the active systems
+	for (auto entity : entitiesToBeKilled) {
+		// The same handle could have been queued twice in one frame
+		if (!IsAlive(entity)) {
+			continue;
+		}
+
+		const auto entityId = entity.GetId();
+
+		RemoveEntityFromSystems(entity);
+
+		if (storageMode == StorageMode::Archetypes) {
+			archetypes.RemoveEntity(entityId);
+		} else {
+			for (auto& pool : componentPools) {
+				if (pool) {
+					pool->RemoveEntityFromPool(entityId);
+				}
+			}
+		}
+
+		entityComponentSignatures[entityId].reset();
+
+		// Invalidate every outstanding handle to this entity and make the id available again
+		entityGenerations[entityId]++;
+		freeIds.push_back(entityId);
+
+		LOG_DEBUG(LogCategory::ECS, "Entity killed with id = {}", entityId);
 	}
 
-	entitiesToBeAdded.clear();
+	entitiesToBeKilled.clear();
+
+	// Everything added or changed from here on belongs to the next tick
+	currentTick++;
 }
 
-void Registry::AddEntityToSystems(Entity entity) {
+void Registry::MatchEntityWithSystems(Entity entity) {
 	const auto entityId = entity.GetId();
 
 	// entityComponentSignature math with systemComponentSignature
 	const auto& entityComponentSignature = entityComponentSignatures[entityId];
-	
-	
-	for (auto& system: systems) {
-		const auto& systemComponentSignature = system.second->GetComponentSignature();
+
+	for (auto* system : systemList) {
+		const auto& systemComponentSignature = system->GetComponentSignature();
 
 		bool isInterested = (entityComponentSignature & systemComponentSignature) == systemComponentSignature;
 
 		if (isInterested) {
-			system.second->AddEntityToSystem(entity);
+			system->AddEntityToSystem(entity);
+		} else {
+			system->RemoveEntityFromSystem(entity);
 		}
 	}
 }
 
+void Registry::MatchRematchedEntities() {
+	const int count = static_cast<int>(entitiesToBeRematched.size());
+	if (count == 0) {
+		return;
+	}
+
+	// Gather the signatures into one contiguous array so every system can test them in a single pass
+	rematchSignatures.resize(count);
+	rematchResults.resize(count);
+	for (int i = 0; i < count; i++) {
+		const auto entityId = entitiesToBeRematched[i];
+		entityNeedsRematch[entityId] = false;
+		rematchSignatures[i] = entityComponentSignatures[entityId];
+	}
+
+	for (auto* system : systemList) {
+		MatchSignatures(rematchSignatures.data(), count, system->GetComponentSignature(), rematchResults.data());
+
+		for (int i = 0; i < count; i++) {
+			const auto entityId = entitiesToBeRematched[i];
+			Entity entity(entityId, entityGenerations[entityId]);
+			entity.registry = this;
+
+			if (rematchResults[i]) {
+				system->AddEntityToSystem(entity);
+			} else {
+				system->RemoveEntityFromSystem(entity);
+			}
+		}
+	}
+
+	entitiesToBeRematched.clear();
+}
+
+void Registry::FindEntities(const Signature& signature, std::vector<Entity>& result) const {
+	const int count = static_cast<int>(entityComponentSignatures.size());
+	result.clear();
+	if (count == 0) {
+		return;
+	}
+
+	std::vector<uint8_t> matches(count);
+	MatchSignatures(entityComponentSignatures.data(), count, signature, matches.data());
+
+	for (int entityId = 0; entityId < count; entityId++) {
+		// Free ids have an empty signature, they would match an empty query
+		if (matches[entityId] && entityComponentSignatures[entityId].any()) {
+			Entity entity(entityId, entityGenerations[entityId]);
+			entity.registry = const_cast<Registry*>(this);
+			result.push_back(entity);
+		}
+	}
+}
+
+void Registry::GetStorageStats(std::vector<StorageStats>& stats) const {
+	stats.clear();
+	if (storageMode == StorageMode::Archetypes) {
+		archetypes.GetStats(stats);
+		return;
+	}
+
+	for (const auto& componentPool : componentPools) {
+		if (componentPool) {
+			stats.emplace_back();
+			componentPool->GetStats(stats.back());
+		}
+	}
+}
+
+void Registry::RemoveEntityFromSystems(Entity entity) {
+	for (auto* system : systemList) {
+		system->RemoveEntityFromSystem(entity);
+	}
+}
+
 
@@ -1,16 +1,158 @@
 #ifndef ECS_H
 #define ECS_H
-#include <bitset>
 #include <vector>
 #include <unordered_map>
 #include <typeindex>
-#include <set>
+#include <mutex>
+#include <deque>
 #include <memory>
+#include <cstdint>
+#include <tuple>
+#include <new>
+#include <cassert>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
+#include <string>
 #include "../Logger/Logger.h"
+#include "../Memory/MemoryTracker.h"
 
+class JobSystem;
+class EventBus;
 
-constexpr unsigned int MAX_COMPONENTS = 32;
-typedef std::bitset<MAX_COMPONENTS> Signature;
+
+// Number of component types the ECS supports, can be set to 64, 128 or 256 from the build
+#ifndef ECS_MAX_COMPONENTS
+#define ECS_MAX_COMPONENTS 64
+#endif
+
+constexpr unsigned int MAX_COMPONENTS = ECS_MAX_COMPONENTS;
+static_assert(MAX_COMPONENTS == 64 || MAX_COMPONENTS == 128 || MAX_COMPONENTS == 256,
+	"ECS_MAX_COMPONENTS must be 64, 128 or 256");
+
+// Set of component ids.
+// Same interface as the std::bitset we used to use, but stored as plain 64 bit words
+// so MatchSignatures can test whole batches of signatures with SIMD.
+class Signature {
+public:
+	static constexpr int NUM_WORDS = MAX_COMPONENTS / 64;
+private:
+	uint64_t words[NUM_WORDS] = {};
+public:
+	Signature() = default;
+
+	Signature& set(size_t position, bool value = true) {
+		const uint64_t bit = uint64_t(1) << (position % 64);
+		if (value) {
+			words[position / 64] |= bit;
+		} else {
+			words[position / 64] &= ~bit;
+		}
+		return *this;
+	}
+
+	Signature& reset() {
+		for (auto& word : words) {
+			word = 0;
+		}
+		return *this;
+	}
+
+	bool test(size_t position) const {
+		return (words[position / 64] >> (position % 64)) & 1;
+	}
+
+	bool any() const {
+		uint64_t combined = 0;
+		for (auto word : words) {
+			combined |= word;
+		}
+		return combined != 0;
+	}
+
+	bool none() const { return !any(); }
+
+	uint64_t GetWord(int index) const { return words[index]; }
+
+	Signature operator &(const Signature& other) const {
+		Signature result;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			result.words[i] = words[i] & other.words[i];
+		}
+		return result;
+	}
+
+	Signature operator |(const Signature& other) const {
+		Signature result;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			result.words[i] = words[i] | other.words[i];
+		}
+		return result;
+	}
+
+	bool operator ==(const Signature& other) const {
+		for (int i = 0; i < NUM_WORDS; i++) {
+			if (words[i] != other.words[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool operator !=(const Signature& other) const { return !(*this == other); }
+};
+
+namespace std {
+	template <>
+	struct hash<Signature> {
+		size_t operator()(const Signature& signature) const {
+			uint64_t hash = 14695981039346656037ull;
+			for (int i = 0; i < Signature::NUM_WORDS; i++) {
+				hash = (hash ^ signature.GetWord(i)) * 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+}
+
+// Non owning view of a contiguous array, used by the batch functions.
+// std::span would do but it is C++20 and we build as C++17
+template <typename T>
+class Span {
+private:
+	T* first = nullptr;
+	size_t count = 0;
+public:
+	Span() = default;
+	Span(T* data, size_t size) : first(data), count(size) {}
+	template <typename TContainer>
+	Span(TContainer& container) : first(container.data()), count(container.size()) {}
+
+	T* data() const { return first; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T& operator [](size_t index) const { return first[index]; }
+	T* begin() const { return first; }
+	T* end() const { return first + count; }
+};
+
+// results[i] = 1 if signatures[i] has every bit of mask set, 0 otherwise.
+// Uses AVX2 or SSE2 when the build enables them (define ECS_NO_SIMD to force the scalar loop)
+void MatchSignatures(const Signature* signatures, int count, const Signature& mask, uint8_t* results);
+
+// typeid(T).name() without the "class " / "struct " MSVC puts in front, for debug displays
+std::string GetDisplayTypeName(const char* typeName);
+
+// Size and occupancy of one component pool or archetype, for debug displays
+struct StorageStats {
+	std::string name;
+	// Components (or entities for an archetype) stored
+	int size;
+	// Room before the storage has to grow
+	int capacity;
+	// Bytes one stored item takes
+	size_t itemSize;
+};
 
 
 /*
@@ -23,16 +165,36 @@ typedef std::bitset<MAX_COMPONENTS> Signature;
 */
 struct IComponent {
 protected:
-	static int nextId;
+	// Hands out the next component id, stops the program if we run out of signature bits
+	static int NextId();
+};
+
+// Type erased description of a component type.
+// Used by storage that keeps components of different types in raw memory (archetype chunks)
+struct ComponentTypeInfo {
+	size_t size;
+	size_t alignment;
+	void (*moveConstruct)(void* destination, void* source);
+	void (*destroy)(void* component);
 };
 
 template <typename TComponent>
 class Component: public IComponent {
 public:
 	static int GetId() {
-		static auto id = nextId++;
+		static auto id = NextId();
 		return id;
 	}
+
+	static const ComponentTypeInfo& GetTypeInfo() {
+		static const ComponentTypeInfo typeInfo = {
+			sizeof(TComponent),
+			alignof(TComponent),
+			[](void* destination, void* source) { new (destination) TComponent(std::move(*static_cast<TComponent*>(source))); },
+			[](void* component) { static_cast<TComponent*>(component)->~TComponent(); }
+		};
+		return typeInfo;
+	}
 };
 
 /*
@@ -47,21 +209,32 @@ public:
 // Forward declaration of registry so we can use it's type in Entity
 //class Registry;
 
+// An entity handle packs a 32 bit index with a 32 bit generation.
+// The index is what we use to index signatures and pools (GetId).
+// The generation is bumped every time the registry recycles the index, so a handle
+// that outlived its entity can be detected in O(1) by comparing generations.
 class Entity {
 private:
-	int id;
+	uint64_t handle;
 public:
-	Entity(int id) : id(id) {};
+	Entity(int id, uint32_t generation = 0)
+		: handle((static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(id)) {};
 	Entity(const Entity& entity) = default;
 	Entity& operator =(const Entity& other) = default;
-	bool operator ==(const Entity& other) const { return id == other.id; }
-	bool operator <(const Entity& other) const { return id < other.id;  }
-	const int GetId() const { return id; }
+	bool operator ==(const Entity& other) const { return handle == other.handle; }
+	bool operator !=(const Entity& other) const { return handle != other.handle; }
+	bool operator <(const Entity& other) const { return handle < other.handle;  }
+	const int GetId() const { return static_cast<int>(handle & 0xFFFFFFFF); }
+	uint32_t GetGeneration() const { return static_cast<uint32_t>(handle >> 32); }
+	uint64_t GetHandle() const { return handle; }
+
+	void Kill();
 
 	template <typename TComponent, typename ...TArgs> void AddComponent(TArgs&& ...args);
 	template <typename TComponent> void RemoveComponent();
 	template <typename TComponent> bool HasComponent() const;
 	template <typename TComponent> TComponent& GetComponent() const;
+	template <typename TComponent> TComponent& GetMutableComponent() const;
 
 	// Instead of forward declaring registry we can declare and use it here
 	class Registry* registry;
@@ -79,17 +252,40 @@ public:
 class System {
 private:
 	Signature componentSignature;
-	std::vector<Entity> entities;
+	// Components the system reads and writes while updating, used by the SystemScheduler
+	// to decide which systems can run at the same time
+	Signature readSignature;
+	Signature writeSignature;
+	TrackedVector<Entity> entities{ TrackingAllocator<Entity>(MemoryTag::SystemLists) };
+	// index = entityId, value = slot in entities or -1
+	// Lets us check membership and swap-remove in O(1)
+	TrackedVector<int> entityIdToSlot{ TrackingAllocator<int>(MemoryTag::SystemLists) };
+	// Bumped every time an entity joins or leaves the system
+	uint32_t membershipVersion = 0;
+	// Set by Registry::AddSystem
+	std::string name;
 public:
 	System() = default;
 	~System() = default;
 
+	// Both are no-ops if the entity is already in / not in the system
 	void AddEntityToSystem(Entity entity);
 	void RemoveEntityFromSystem(Entity entity);
-	const std::vector<Entity>& GetSystemEntities() const { return entities; }
+	bool HasEntity(Entity entity) const;
+	const TrackedVector<Entity>& GetSystemEntities() const { return entities; }
+	uint32_t GetMembershipVersion() const { return membershipVersion; }
 	const Signature& GetComponentSignature() const { return componentSignature; }
+	const std::string& GetName() const { return name; }
+	void SetName(const std::string& systemName) { name = systemName; }
+
+	const Signature& GetReadSignature() const { return readSignature; }
+	const Signature& GetWriteSignature() const { return writeSignature; }
+	// Two systems conflict if one of them writes a component the other one reads or writes
+	bool ConflictsWith(const System& other) const;
 
 	template <typename TComponent> void RequireComponent();
+	template <typename TComponent> void ReadsComponent();
+	template <typename TComponent> void WritesComponent();
 };
 
 /*
@@ -103,55 +299,634 @@ public:
 
 class IPool {
 public:
-	virtual ~IPool() = 0 {}
+	virtual ~IPool() = default;
+	virtual void RemoveEntityFromPool(int entityId) = 0;
+	virtual void GetStats(StorageStats& stats) const = 0;
 };
 
+// Sparse set of components.
+// data and entityIds are packed and parallel: data[i] belongs to entity entityIds[i].
+// entityIdToIndex is the sparse side and maps an entity id to its slot in data.
+// Memory scales with the number of components that exist (plus one int per entity id
+// for the sparse lookup), and iterating data is a straight linear scan with no holes.
 template <typename TComponent>
 class Pool: public IPool {
 private:
-	std::vector<TComponent> data;
+	TrackedVector<TComponent> data{ TrackingAllocator<TComponent>(GetMemoryTag()) };
+	// packed index = data index, value = entityId
+	TrackedVector<int> entityIds{ TrackingAllocator<int>(GetMemoryTag()) };
+	// index = entityId, value = data index or INVALID_INDEX
+	TrackedVector<int> entityIdToIndex{ TrackingAllocator<int>(GetMemoryTag()) };
+	// Parallel to data: registry tick at which the component was added and last changed.
+	// A component only counts as changed when it is written through MarkChanged / GetMutableComponent
+	TrackedVector<uint32_t> addedTicks{ TrackingAllocator<uint32_t>(GetMemoryTag()) };
+	TrackedVector<uint32_t> changedTicks{ TrackingAllocator<uint32_t>(GetMemoryTag()) };
 public:
-	Pool(int size = 100) {
-		data.resize(size);
+	static constexpr int INVALID_INDEX = -1;
+
+	// Every pool of this component type (one per registry) counts against the same tag
+	static MemoryTag GetMemoryTag() {
+		static const MemoryTag tag = MemoryTracker::RegisterTag("Pool<" + GetDisplayTypeName(typeid(TComponent).name()) + ">");
+		return tag;
 	}
 
-	~Pool() = default;
+	Pool(int capacity = 100) {
+		Reserve(capacity);
+	}
+
+	~Pool() override = default;
 
 	bool IsEmpty() const {
 		return data.empty();
 	}
 
 	int GetSize() const {
-		return data.size();
+		return static_cast<int>(data.size());
 	}
 
-	void Resize(int n) {
-		data.resize(n);
+	void Reserve(int n) {
+		data.reserve(n);
+		entityIds.reserve(n);
+		addedTicks.reserve(n);
+		changedTicks.reserve(n);
+	}
+
+	// Makes room in the sparse array for ids up to maxEntityId so a batch of Sets doesn't regrow it
+	void ReserveEntityIds(int maxEntityId) {
+		if (maxEntityId >= static_cast<int>(entityIdToIndex.size())) {
+			entityIdToIndex.resize(maxEntityId + 1, INVALID_INDEX);
+		}
 	}
 
 	void Clear() {
 		data.clear();
+		entityIds.clear();
+		entityIdToIndex.clear();
+		addedTicks.clear();
+		changedTicks.clear();
 	}
 
-	void Add(TComponent& component) {
-		data.push_back(component);
+	bool Has(int entityId) const {
+		return entityId >= 0 &&
+			entityId < static_cast<int>(entityIdToIndex.size()) &&
+			entityIdToIndex[entityId] != INVALID_INDEX;
 	}
 
-	void Set(int index, TComponent& component) {
-		data[index] = component;
+	// Overwrites the component if the entity already has one, otherwise appends it to the packed array
+	void Set(int entityId, TComponent component, uint32_t tick = 0) {
+		if (Has(entityId)) {
+			const int index = entityIdToIndex[entityId];
+			data[index] = std::move(component);
+			changedTicks[index] = tick;
+			return;
+		}
+
+		if (entityId >= static_cast<int>(entityIdToIndex.size())) {
+			entityIdToIndex.resize(entityId + 1, INVALID_INDEX);
+		}
+
+		entityIdToIndex[entityId] = static_cast<int>(data.size());
+		entityIds.push_back(entityId);
+		data.push_back(std::move(component));
+		addedTicks.push_back(tick);
+		changedTicks.push_back(tick);
 	}
 
+	// Swap and pop: move the last component into the removed slot so the array stays packed
 	void Remove(int entityId) {
-		data.erase(entityId);
+		if (!Has(entityId)) {
+			return;
+		}
+
+		const int indexOfRemoved = entityIdToIndex[entityId];
+		const int indexOfLast = static_cast<int>(data.size()) - 1;
+
+		if (indexOfRemoved != indexOfLast) {
+			const int entityIdOfLast = entityIds[indexOfLast];
+			data[indexOfRemoved] = std::move(data[indexOfLast]);
+			entityIds[indexOfRemoved] = entityIdOfLast;
+			addedTicks[indexOfRemoved] = addedTicks[indexOfLast];
+			changedTicks[indexOfRemoved] = changedTicks[indexOfLast];
+			entityIdToIndex[entityIdOfLast] = indexOfRemoved;
+		}
+
+		data.pop_back();
+		entityIds.pop_back();
+		addedTicks.pop_back();
+		changedTicks.pop_back();
+		entityIdToIndex[entityId] = INVALID_INDEX;
+	}
+
+	void RemoveEntityFromPool(int entityId) override {
+		Remove(entityId);
 	}
 
-	TComponent& Get(int index) {
-		return static_cast<TComponent&>(data[index]);
+	void GetStats(StorageStats& stats) const override {
+		stats.name = GetDisplayTypeName(typeid(TComponent).name());
+		stats.size = GetSize();
+		stats.capacity = static_cast<int>(data.capacity());
+		// The packed entity id and the two ticks travel with every component
+		stats.itemSize = sizeof(TComponent) + sizeof(int) + 2 * sizeof(uint32_t);
 	}
 
+	// Lookup by entity id, the entity must have the component
+	TComponent& Get(int entityId) {
+		return data[entityIdToIndex[entityId]];
+	}
+
+	// Stamps the component as changed at tick, the entity must have the component
+	void MarkChanged(int entityId, uint32_t tick) {
+		changedTicks[entityIdToIndex[entityId]] = tick;
+	}
+
+	uint32_t GetAddedTick(int entityId) const {
+		return addedTicks[entityIdToIndex[entityId]];
+	}
+
+	uint32_t GetChangedTick(int entityId) const {
+		return changedTicks[entityIdToIndex[entityId]];
+	}
+
+	// Packed access: index is a slot in data, not an entity id
 	TComponent& operator [](unsigned int index) {
 		return data[index];
 	}
+
+	int GetEntityId(int index) const {
+		return entityIds[index];
+	}
+
+	const TrackedVector<int>& GetEntityIds() const {
+		return entityIds;
+	}
+
+	TrackedVector<TComponent>& GetData() {
+		return data;
+	}
+};
+
+/*
+*
+* ===============================================================================
+* +																				+
+* +						VIEW													+
+* +																				+
+* ===============================================================================
+*/
+
+// A view over every entity that has all of TComponents.
+// The raw pool pointers are resolved once when the view is created, so iterating it
+// never touches the shared_ptrs in the registry. Iteration walks the packed entity
+// array of the smallest pool and does a sparse lookup into the others.
+// Dereferencing yields a tuple of (Entity, TComponents&...):
+//
+//	for (auto [entity, transform, rigidbody] : registry.View<TransformComponent, RigidBodyComponent>()) { ... }
+//
+// Adding or removing components of the viewed types while iterating invalidates the view.
+//
+// Views can be narrowed down to components added or changed at or after a registry tick:
+//
+//	registry.View<TransformComponent, SpriteComponent>().Changed<SpriteComponent>(lastTick)
+//
+// so systems can only look at what moved on since they last ran.
+constexpr int MAX_VIEW_FILTERS = 4;
+
+template <typename ...TComponents>
+class ComponentView {
+private:
+	struct Filter {
+		const void* pool;
+		bool (*passes)(const void* pool, int entityId, uint32_t sinceTick);
+		uint32_t sinceTick;
+	};
+
+	std::tuple<Pool<TComponents>*...> pools;
+	Filter filters[MAX_VIEW_FILTERS];
+	int numFilters = 0;
+	// Packed entity ids of the smallest pool, this is what we iterate
+	const TrackedVector<int>* entityIds = nullptr;
+	const std::vector<uint32_t>* entityGenerations = nullptr;
+	class Registry* registry = nullptr;
+
+	bool Contains(int entityId) const {
+		if (!std::apply([entityId](auto* ...pool) { return (pool->Has(entityId) && ...); }, pools)) {
+			return false;
+		}
+
+		for (int i = 0; i < numFilters; i++) {
+			if (!filters[i].passes(filters[i].pool, entityId, filters[i].sinceTick)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename TComponent>
+	ComponentView WithFilter(Pool<TComponent>* pool, bool (*passes)(const void*, int, uint32_t), uint32_t sinceTick) const {
+		assert(numFilters < MAX_VIEW_FILTERS && "Too many filters on one view");
+
+		ComponentView filtered = *this;
+		if (!pool) {
+			// Nothing has this component, nothing can pass the filter
+			filtered.entityIds = nullptr;
+			return filtered;
+		}
+
+		filtered.filters[filtered.numFilters++] = { pool, passes, sinceTick };
+		return filtered;
+	}
+
+public:
+	class Iterator {
+	private:
+		const ComponentView* view;
+		int index;
+
+		void SkipToValid() {
+			const int size = static_cast<int>(view->entityIds->size());
+			while (index < size && !view->Contains((*view->entityIds)[index])) {
+				index++;
+			}
+		}
+	public:
+		Iterator(const ComponentView* view, int index) : view(view), index(index) {
+			if (view->entityIds) {
+				SkipToValid();
+			}
+		}
+
+		std::tuple<Entity, TComponents&...> operator *() const {
+			const int entityId = (*view->entityIds)[index];
+			Entity entity(entityId, (*view->entityGenerations)[entityId]);
+			entity.registry = view->registry;
+			return std::tuple<Entity, TComponents&...>(entity, std::get<Pool<TComponents>*>(view->pools)->Get(entityId)...);
+		}
+
+		Iterator& operator ++() {
+			index++;
+			SkipToValid();
+			return *this;
+		}
+
+		bool operator ==(const Iterator& other) const { return index == other.index; }
+		bool operator !=(const Iterator& other) const { return index != other.index; }
+	};
+
+	ComponentView() = default;
+
+	ComponentView(Pool<TComponents>* ...componentPools, const std::vector<uint32_t>* entityGenerations, class Registry* registry)
+		: pools(componentPools...), entityGenerations(entityGenerations), registry(registry) {
+		// If any of the pools does not exist yet no entity can match
+		if (((componentPools == nullptr) || ...)) {
+			return;
+		}
+
+		// Iterate the smallest pool, every other pool is only used for lookups
+		entityIds = &std::get<0>(pools)->GetEntityIds();
+		std::apply([this](auto* ...pool) {
+			((pool->GetEntityIds().size() < entityIds->size() ? (void)(entityIds = &pool->GetEntityIds()) : (void)0), ...);
+		}, pools);
+	}
+
+	// Only entities whose TComponent was changed at or after sinceTick
+	template <typename TComponent> ComponentView Changed(uint32_t sinceTick) const;
+	// Only entities whose TComponent was added at or after sinceTick
+	template <typename TComponent> ComponentView Added(uint32_t sinceTick) const;
+
+	Iterator begin() const { return Iterator(this, 0); }
+	Iterator end() const { return Iterator(this, entityIds ? static_cast<int>(entityIds->size()) : 0); }
+
+	// Upper bound on the number of entities in the view (the size of the smallest pool)
+	int SizeHint() const { return entityIds ? static_cast<int>(entityIds->size()) : 0; }
+
+	// Calls func(Entity, TComponents&...) for every entity in the view
+	template <typename TFunc>
+	void Each(TFunc&& func) const {
+		EachInRange(0, SizeHint(), func);
+	}
+
+	// Same as Each but only for the packed slots [first, last) of the iterated pool.
+	// Disjoint ranges never visit the same entity, so they can run on different threads
+	template <typename TFunc>
+	void EachInRange(int first, int last, TFunc&& func) const {
+		if (!entityIds) {
+			return;
+		}
+
+		last = std::min(last, SizeHint());
+		for (int index = first; index < last; index++) {
+			const int entityId = (*entityIds)[index];
+			if (!Contains(entityId)) {
+				continue;
+			}
+
+			Entity entity(entityId, (*entityGenerations)[entityId]);
+			entity.registry = registry;
+			func(entity, std::get<Pool<TComponents>*>(pools)->Get(entityId)...);
+		}
+	}
+};
+
+/*
+*
+* ===============================================================================
+* +																				+
+* +						ARCHETYPE												+
+* +																				+
+* ===============================================================================
+*/
+
+// Alternative to the per type pools.
+// Every distinct Signature gets an archetype, and the entities of an archetype are stored in
+// fixed size chunks. Inside a chunk each component type is its own contiguous column (SoA),
+// followed by a column with the entity ids. Queries match whole archetypes by signature once
+// and then walk the columns linearly.
+constexpr size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+constexpr size_t ARCHETYPE_CHUNK_ALIGNMENT = 64;
+
+struct alignas(ARCHETYPE_CHUNK_ALIGNMENT) ArchetypeChunkMemory {
+	unsigned char bytes[ARCHETYPE_CHUNK_SIZE];
+};
+
+struct ArchetypeChunk {
+	int count = 0;
+	std::unique_ptr<ArchetypeChunkMemory> memory = std::make_unique<ArchetypeChunkMemory>();
+};
+
+struct Archetype {
+	Signature signature;
+	// Sorted component ids, one column per id
+	std::vector<int> componentIds;
+	// Parallel to componentIds, byte offset of the column inside a chunk
+	std::vector<size_t> columnOffsets;
+	// Parallel to componentIds
+	std::vector<const ComponentTypeInfo*> columnTypes;
+	// index = componentId, value = column index or -1
+	int columnIndices[MAX_COMPONENTS];
+	size_t entityIdsOffset = 0;
+	int chunkCapacity = 0;
+	int numEntities = 0;
+	std::vector<ArchetypeChunk> chunks;
+
+	void* GetComponent(int column, int chunk, int index) const {
+		return chunks[chunk].memory->bytes + columnOffsets[column] + columnTypes[column]->size * index;
+	}
+
+	int* GetEntityIds(int chunk) const {
+		return reinterpret_cast<int*>(chunks[chunk].memory->bytes + entityIdsOffset);
+	}
+};
+
+class ArchetypeStorage {
+private:
+	struct EntityLocation {
+		Archetype* archetype = nullptr;
+		int chunk = 0;
+		int index = 0;
+	};
+
+	std::vector<std::unique_ptr<Archetype>> archetypes;
+	std::unordered_map<Signature, Archetype*> archetypesBySignature;
+	// index = componentId
+	std::vector<const ComponentTypeInfo*> componentTypes;
+	// index = entityId
+	std::vector<EntityLocation> entityLocations;
+
+	Archetype* GetOrCreateArchetype(const Signature& signature);
+	// Moves the entity into the archetype for newSignature, moving over the components both archetypes share
+	// and destroying the ones the new archetype does not have. Returns the new location
+	EntityLocation MoveEntity(int entityId, const Signature& newSignature);
+	// Destroys the components at a location and fills the hole with the last entity of the archetype
+	void RemoveFromArchetype(const EntityLocation& location, bool destroyComponents);
+public:
+	ArchetypeStorage() = default;
+	~ArchetypeStorage();
+	ArchetypeStorage(const ArchetypeStorage&) = delete;
+	ArchetypeStorage& operator =(const ArchetypeStorage&) = delete;
+
+	template <typename TComponent, typename ...TArgs> void AddComponent(int entityId, TArgs&& ...args);
+	template <typename TComponent> void RemoveComponent(int entityId);
+	template <typename TComponent> TComponent& GetComponent(int entityId) const;
+	bool HasComponent(int entityId, int componentId) const;
+	void RemoveEntity(int entityId);
+
+	// Calls func(entityId, TComponents&...) for every entity whose archetype has all of TComponents
+	template <typename ...TComponents, typename TFunc> void Each(TFunc&& func);
+	// Same as Each but only for entities [first, last) in the order Each visits them
+	template <typename ...TComponents, typename TFunc> void EachInRange(int first, int last, TFunc&& func);
+	// Number of entities Each<TComponents...> visits
+	template <typename ...TComponents> int EachSize() const;
+
+	int GetNumArchetypes() const { return static_cast<int>(archetypes.size()); }
+	// Appends one entry per archetype, capacity counts every slot in its chunks
+	void GetStats(std::vector<StorageStats>& stats) const;
+};
+
+template <typename TComponent, typename ...TArgs>
+void ArchetypeStorage::AddComponent(int entityId, TArgs&& ...args) {
+	static_assert(alignof(TComponent) <= ARCHETYPE_CHUNK_ALIGNMENT, "Component alignment is too large for an archetype chunk");
+
+	const auto componentId = Component<TComponent>::GetId();
+
+	if (componentId >= static_cast<int>(componentTypes.size())) {
+		componentTypes.resize(componentId + 1, nullptr);
+	}
+	componentTypes[componentId] = &Component<TComponent>::GetTypeInfo();
+
+	if (HasComponent(entityId, componentId)) {
+		GetComponent<TComponent>(entityId) = TComponent(std::forward<TArgs>(args)...);
+		return;
+	}
+
+	Signature newSignature;
+	if (entityId < static_cast<int>(entityLocations.size()) && entityLocations[entityId].archetype) {
+		newSignature = entityLocations[entityId].archetype->signature;
+	}
+	newSignature.set(componentId);
+
+	// The new column is left uninitialized by MoveEntity, construct the component in place
+	const auto location = MoveEntity(entityId, newSignature);
+	const int column = location.archetype->columnIndices[componentId];
+	new (location.archetype->GetComponent(column, location.chunk, location.index)) TComponent(std::forward<TArgs>(args)...);
+}
+
+template <typename TComponent>
+void ArchetypeStorage::RemoveComponent(int entityId) {
+	const auto componentId = Component<TComponent>::GetId();
+
+	if (!HasComponent(entityId, componentId)) {
+		return;
+	}
+
+	Signature newSignature = entityLocations[entityId].archetype->signature;
+	newSignature.set(componentId, false);
+
+	if (newSignature.none()) {
+		RemoveEntity(entityId);
+		return;
+	}
+
+	MoveEntity(entityId, newSignature);
+}
+
+template <typename TComponent>
+TComponent& ArchetypeStorage::GetComponent(int entityId) const {
+	const auto& location = entityLocations[entityId];
+	const int column = location.archetype->columnIndices[Component<TComponent>::GetId()];
+	return *static_cast<TComponent*>(location.archetype->GetComponent(column, location.chunk, location.index));
+}
+
+template <typename ...TComponents, typename TFunc>
+void ArchetypeStorage::Each(TFunc&& func) {
+	EachInRange<TComponents...>(0, std::numeric_limits<int>::max(), func);
+}
+
+template <typename ...TComponents, typename TFunc>
+void ArchetypeStorage::EachInRange(int first, int last, TFunc&& func) {
+	Signature querySignature;
+	(querySignature.set(Component<TComponents>::GetId()), ...);
+
+	// Index of the first entity of the current chunk in iteration order
+	int chunkStart = 0;
+
+	for (auto& archetype : archetypes) {
+		// One signature test per archetype instead of one per entity
+		if ((archetype->signature & querySignature) != querySignature) {
+			continue;
+		}
+
+		for (int chunk = 0; chunk < static_cast<int>(archetype->chunks.size()) && chunkStart < last; chunk++) {
+			const int count = archetype->chunks[chunk].count;
+			const int begin = std::max(first - chunkStart, 0);
+			const int end = std::min(last - chunkStart, count);
+			chunkStart += count;
+
+			if (begin >= end) {
+				continue;
+			}
+
+			const int* entityIds = archetype->GetEntityIds(chunk);
+			auto componentArrays = std::make_tuple(
+				static_cast<TComponents*>(archetype->GetComponent(archetype->columnIndices[Component<TComponents>::GetId()], chunk, 0))...);
+
+			for (int i = begin; i < end; i++) {
+				func(entityIds[i], std::get<TComponents*>(componentArrays)[i]...);
+			}
+		}
+	}
+}
+
+template <typename ...TComponents>
+int ArchetypeStorage::EachSize() const {
+	Signature querySignature;
+	(querySignature.set(Component<TComponents>::GetId()), ...);
+
+	int size = 0;
+	for (const auto& archetype : archetypes) {
+		if ((archetype->signature & querySignature) == querySignature) {
+			size += archetype->numEntities;
+		}
+	}
+	return size;
+}
+
+/*
+*
+* ===============================================================================
+* +																				+
+* +						COMMAND BUFFER											+
+* +																				+
+* ===============================================================================
+*/
+
+// Handle to an entity created through a CommandBuffer. The real entity only exists once the
+// buffer has been played back, until then it can only be used with the buffer that created it.
+struct DeferredEntity {
+	int index;
+};
+
+// Records structural changes (create, kill, add component, remove component) so they can be made
+// from systems running on worker threads. Every thread gets its own buffer from
+// Registry::GetCommandBuffer, so recording never takes a lock.
+//
+// Commands are written back to back into a linear arena of fixed size blocks: a header followed by
+// the payload (the component being added, constructed in place). Blocks are kept between frames so
+// recording doesn't allocate once the arena has grown to its working size.
+//
+// Registry::Update plays every buffer back ordered by (sort key, recording order). The sort key
+// is set per thread: the SystemScheduler sets it to the task and range being run, so the order
+// doesn't depend on which worker happened to run which range. Commands recorded outside the
+// scheduler have sort key 0 and are played back first.
+class CommandBuffer {
+public:
+	enum class CommandType : uint8_t {
+		CreateEntity,
+		KillEntity,
+		AddComponent,
+		RemoveComponent
+	};
+
+	struct CommandHeader {
+		CommandType type;
+		// Bytes from this header to the next command in the block
+		uint32_t size;
+		uint32_t sequence;
+		uint64_t sortKey;
+		// Target of the command, deferredIndex is used instead when it is not -1
+		Entity entity = Entity(0);
+		int deferredIndex = -1;
+		void (*apply)(class Registry& registry, Entity entity, void* payload) = nullptr;
+		void (*destroy)(void* payload) = nullptr;
+
+		void* GetPayload();
+	};
+
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+	static constexpr size_t COMMAND_ALIGNMENT = alignof(std::max_align_t);
+private:
+	struct Block {
+		std::unique_ptr<unsigned char[]> bytes;
+		size_t used = 0;
+		size_t capacity = 0;
+	};
+
+	std::vector<Block> blocks;
+	int currentBlock = 0;
+	uint32_t numCommands = 0;
+	int numDeferredEntities = 0;
+	// index = DeferredEntity::index, filled in during playback
+	std::vector<Entity> createdEntities;
+
+	static thread_local uint64_t threadSortKey;
+
+	CommandHeader* Allocate(CommandType type, size_t payloadSize);
+	template <typename TComponent, typename ...TArgs> void RecordAddComponent(Entity entity, int deferredIndex, TArgs&& ...args);
+	Entity ResolveTarget(const CommandHeader& command) const;
+	friend class Registry;
+public:
+	CommandBuffer() = default;
+	~CommandBuffer();
+	CommandBuffer(const CommandBuffer&) = delete;
+	CommandBuffer& operator =(const CommandBuffer&) = delete;
+
+	DeferredEntity CreateEntity();
+	void KillEntity(Entity entity);
+	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
+	template <typename TComponent, typename ...TArgs> void AddComponent(DeferredEntity entity, TArgs&& ...args);
+	template <typename TComponent> void RemoveComponent(Entity entity);
+
+	bool IsEmpty() const { return numCommands == 0; }
+	int GetNumCommands() const { return static_cast<int>(numCommands); }
+
+	// Calls func(CommandHeader&) for every recorded command in recording order
+	template <typename TFunc> void ForEachCommand(TFunc&& func);
+
+	// Destroys every recorded payload and rewinds the arena, keeping its memory
+	void Clear();
+
+	// Sort key stamped on every command recorded by the calling thread from now on
+	static void SetThreadSortKey(uint64_t sortKey) { threadSortKey = sortKey; }
+	static uint64_t GetThreadSortKey() { return threadSortKey; }
 };
 
 /*
@@ -163,46 +938,153 @@ public:
 * ===============================================================================
 */
 
+// Where the registry keeps component data.
+// Pools: one sparse set per component type, fast add/remove, lookups through the sparse array.
+// Archetypes: entities with the same signature share chunks with a column per component type,
+// adding or removing a component moves the entity between archetypes but iteration is contiguous.
+enum class StorageMode {
+	Pools,
+	Archetypes
+};
+
 class Registry {
 private:
 	int numEntities = 0;
-
-	// Set of entities flagged to be added or removed in the current frame
-	std::set<Entity> entitiesToBeAdded;
-	std::set<Entity> entitiesToBeKilled;
+	StorageMode storageMode;
+
+	// Entities whose signature changed (created, component added or removed) this frame.
+	// They are matched against the systems again in one batch in Update
+	std::vector<int> entitiesToBeRematched;
+	// index = entityId, true if the entity is already in entitiesToBeRematched
+	std::vector<uint8_t> entityNeedsRematch;
+	// Scratch space for MatchRematchedEntities, kept between frames so it doesn't allocate
+	TrackedVector<Signature> rematchSignatures{ TrackingAllocator<Signature>(MemoryTag::Signatures) };
+	std::vector<uint8_t> rematchResults;
+	// Entities flagged to be removed in the current frame, in the order they were flagged
+	std::vector<Entity> entitiesToBeKilled;
 	// vector index = componentId
 	std::vector<std::shared_ptr<IPool>> componentPools;
 	// vector index = entityId
-	std::vector<Signature> entityComponentSignatures;
+	TrackedVector<Signature> entityComponentSignatures{ TrackingAllocator<Signature>(MemoryTag::Signatures) };
+	// vector index = entityId, value = generation of the entity currently using that id
+	std::vector<uint32_t> entityGenerations;
+	// Ids of killed entities waiting to be reused by CreateEntity.
+	// Reusing the oldest id first means a slot goes through as few generations as possible.
+	std::deque<int> freeIds;
+	// Only used when storageMode == StorageMode::Archetypes
+	ArchetypeStorage archetypes;
+
+	// One command buffer per thread that recorded into this registry
+	std::vector<std::unique_ptr<CommandBuffer>> commandBuffers;
+	std::mutex commandBuffersMutex;
+	// Tells the thread local buffer caches of different registries apart
+	uint64_t serial;
+	struct PlaybackCommand {
+		uint64_t sortKey;
+		uint32_t sequence;
+		int buffer;
+		CommandBuffer::CommandHeader* command;
+	};
+	// Kept between frames so playback doesn't allocate
+	std::vector<PlaybackCommand> playbackCommands;
+
+	void PlaybackCommandBuffers();
+
 	std::unordered_map<std::type_index, std::shared_ptr<System>> systems;
-public:
-	Registry() {
-		Logger::Log("Registry created!");
-	}
+	// Same systems in a flat list, this is what we loop over when matching entities
+	std::vector<System*> systemList;
+
+	void MatchRematchedEntities();
 
-	~Registry() {
-		Logger::Log("Registry destroyed!");
+	void QueueRematch(int entityId) {
+		if (!entityNeedsRematch[entityId]) {
+			entityNeedsRematch[entityId] = true;
+			entitiesToBeRematched.push_back(entityId);
+		}
 	}
 
+	// Bumped at the end of every Update, components added or changed are stamped with it
+	uint32_t currentTick = 1;
+
+	// Set by whoever owns them. No job system runs everything on the calling thread
+	JobSystem* jobSystem = nullptr;
+	EventBus* eventBus = nullptr;
+
+	void CreateEntitiesInto(int count, std::vector<Entity>& entities);
+	// Shared by the batch functions, componentAt(i) is the component for entities[i]
+	template <typename TComponent, typename TFunc> void AddComponentsWith(Span<const Entity> entities, TFunc&& componentAt);
+
+	// Raw pool lookup, nullptr if no component of this type was ever added.
+	// Avoids copying the shared_ptr (and the atomic refcount traffic that comes with it)
+	template <typename TComponent> Pool<TComponent>* GetPool() const;
+	template <typename ...TComponents> friend class ComponentView;
+public:
+	Registry(StorageMode storageMode = StorageMode::Pools);
+	~Registry();
+	Registry(const Registry&) = delete;
+	Registry& operator =(const Registry&) = delete;
+
 	void Update();
 
 	Entity CreateEntity();
+	// Creates count entities at once, each one gets a copy of the prototype components.
+	// The per entity arrays and pools grow once and the new entities are matched with the systems in one pass
+	template <typename ...TComponents> std::vector<Entity> CreateEntities(int count, const TComponents& ...prototype);
+	void KillEntity(Entity entity);
+	bool IsAlive(Entity entity) const;
+	int GetNumEntities() const { return numEntities - static_cast<int>(freeIds.size()); }
+	// Entity ids handed out so far, alive or waiting in the free list
+	int GetNumEntityIds() const { return numEntities; }
+
+	// Command buffer of the calling thread, safe to call from any thread.
+	// Recorded commands are played back at the start of the next Update
+	CommandBuffer& GetCommandBuffer();
+
+	// Job system systems can split their own work over, see JobSystem::ParallelFor
+	void SetJobSystem(JobSystem* jobSystem) { this->jobSystem = jobSystem; }
+	JobSystem* GetJobSystem() const { return jobSystem; }
+	// Event bus systems subscribe to and publish on, see EventBus
+	void SetEventBus(EventBus* eventBus) { this->eventBus = eventBus; }
+	EventBus* GetEventBus() const { return eventBus; }
 
 	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
+	// Gives entities[i] the component components[i], both spans must be the same size
+	template <typename TComponent> void AddComponents(Span<const Entity> entities, Span<const TComponent> components);
 	template <typename TComponent> void RemoveComponent(Entity entity);
 	template <typename TComponent> bool HasComponent(Entity entity) const;
 	template <typename TComponent> TComponent& GetComponent(Entity entity) const;
-	
-	/*
-	void KillEntity(Entity entity);
-	*/
+	// Same as GetComponent but stamps the component as changed at the current tick
+	template <typename TComponent> TComponent& GetMutableComponent(Entity entity);
+	template <typename TComponent> void MarkChanged(Entity entity);
+	uint32_t GetCurrentTick() const { return currentTick; }
+	// View only covers pool storage, use Each for code that has to work with both storage modes
+	template <typename ...TComponents> ComponentView<TComponents...> View() const;
+	// Calls func(Entity, TComponents&...) for every entity that has all of TComponents
+	template <typename ...TComponents, typename TFunc> void Each(TFunc&& func);
+	// Each split into work items: EachSize is the number of work items (an upper bound on the
+	// number of entities visited) and EachInRange visits work items [first, last).
+	// Disjoint ranges never visit the same entity, so they can be run on different threads
+	template <typename ...TComponents> int EachSize() const;
+	template <typename ...TComponents, typename TFunc> void EachInRange(int first, int last, TFunc&& func);
+
+	// Scans every entity signature and returns the live entities that have all the components in signature
+	void FindEntities(const Signature& signature, std::vector<Entity>& result) const;
+	template <typename ...TComponents> void FindEntitiesWith(std::vector<Entity>& result) const;
+
+	StorageMode GetStorageMode() const { return storageMode; }
+	const ArchetypeStorage& GetArchetypeStorage() const { return archetypes; }
+	// One entry per component pool (or archetype), overwrites stats
+	void GetStorageStats(std::vector<StorageStats>& stats) const;
+	const std::vector<System*>& GetSystems() const { return systemList; }
 
 	template <typename TSystem, typename ...TArgs> void AddSystem(TArgs&& ...args);
 	template <typename TSystem> void RemoveSystem();
 	template <typename TSystem> bool HasSystem() const;
 	template <typename TSystem> TSystem& GetSystem() const;
 
-	void AddEntityToSystems(Entity entity);
+	// Adds the entity to the systems its signature matches and removes it from the others
+	void MatchEntityWithSystems(Entity entity);
+	void RemoveEntityFromSystems(Entity entity);
 };
 
 /*
@@ -220,51 +1102,118 @@ void System::RequireComponent() {
 	componentSignature.set(componentId);
 }
 
+template <typename TComponent>
+void System::ReadsComponent() {
+	const auto componentId = Component<TComponent>::GetId();
+	readSignature.set(componentId);
+}
+
+template <typename TComponent>
+void System::WritesComponent() {
+	const auto componentId = Component<TComponent>::GetId();
+	writeSignature.set(componentId);
+}
+
 template <typename TComponent, typename ...TArgs>
 void Registry::AddComponent(Entity entity, TArgs&& ... args) {
 	const auto componentId = Component<TComponent>::GetId();
 
 	const auto entityId = entity.GetId();
 
-	// if this is a new component, it will not have a pool
-	// or space in the component pools array to insert that pool
-	// resize the array for the pool for this component
-	if (componentId >= componentPools.size()) {
-		componentPools.resize(componentId + 1, nullptr);
+	if (storageMode == StorageMode::Archetypes) {
+		// Moves the entity into the archetype that has this component as well
+		archetypes.AddComponent<TComponent>(entityId, std::forward<TArgs>(args)...);
+	} else {
+		// if this is a new component, it will not have a pool
+		// or space in the component pools array to insert that pool
+		// resize the array for the pool for this component
+		if (componentId >= componentPools.size()) {
+			componentPools.resize(componentId + 1, nullptr);
+		}
+
+		// if this is a new pool
+		// we would have already created space in the component pools array from
+		// the check above, but there will be no pool at this id
+		// create a new pool and add it to component pools
+		if (!componentPools[componentId]) {
+			std::shared_ptr<Pool<TComponent>> newComponentPool = std::make_shared<Pool<TComponent>>();
+			componentPools[componentId] = newComponentPool;
+		}
+
+		// Get the component pool for the given component by using it's id as the index
+		// as thats the scheme we decided to use
+		std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+
+		// The pool is a sparse set so there is no need to resize it to numEntities,
+		// it only grows by the components that actually get added
+		componentPool->Set(entityId, TComponent(std::forward<TArgs>(args)...), currentTick);
 	}
 
-	// if this is a new pool
-	// we would have already created space in the component pools array from
-	// the check above, but there will be no pool at this id
-	// create a new pool and add it to component pools
-	if (!componentPools[componentId]) {
-		std::shared_ptr<Pool<TComponent>> newComponentPool = std::make_shared<Pool<TComponent>>();
-		componentPools[componentId] = newComponentPool;
+	// So we are adding a component to an entity
+	// We need to change the signature of our entity, and the systems it belongs to may change with it
+	entityComponentSignatures[entityId].set(componentId);
+	QueueRematch(entityId);
+
+	LOG_DEBUG(LogCategory::ECS, "Component Id: {} of TYPE: {} was added to entity: {}", componentId, typeid(TComponent).name(), entityId);
+}
+
+template <typename TComponent, typename TFunc>
+void Registry::AddComponentsWith(Span<const Entity> entities, TFunc&& componentAt) {
+	const auto componentId = Component<TComponent>::GetId();
+	const int count = static_cast<int>(entities.size());
+
+	if (storageMode == StorageMode::Archetypes) {
+		for (int i = 0; i < count; i++) {
+			archetypes.AddComponent<TComponent>(entities[i].GetId(), componentAt(i));
+		}
+	} else {
+		if (componentId >= static_cast<int>(componentPools.size())) {
+			componentPools.resize(componentId + 1, nullptr);
+		}
+		if (!componentPools[componentId]) {
+			componentPools[componentId] = std::make_shared<Pool<TComponent>>();
+		}
+		auto* componentPool = static_cast<Pool<TComponent>*>(componentPools[componentId].get());
+
+		// Grow the packed and sparse arrays once for the whole batch
+		int maxEntityId = -1;
+		for (const auto& entity : entities) {
+			maxEntityId = std::max(maxEntityId, entity.GetId());
+		}
+		componentPool->Reserve(componentPool->GetSize() + count);
+		componentPool->ReserveEntityIds(maxEntityId);
+
+		for (int i = 0; i < count; i++) {
+			componentPool->Set(entities[i].GetId(), componentAt(i), currentTick);
+		}
 	}
 
-	// Get the component pool for the given component by using it's id as the index
-	// as thats the scheme we decided to use
-	std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+	for (const auto& entity : entities) {
+		entityComponentSignatures[entity.GetId()].set(componentId);
+		QueueRematch(entity.GetId());
+	}
 
-	// Now that we have a component pool
-	// Remember that we use the entity id to index into this pool
-	// if the current entity id is > pool size, this means we don't have space for all entities in our pool.
-	// resize pool so we have room to insert a component of this specific type for any entity
-	if (entityId >= componentPool->GetSize()) {
-		componentPool->Resize(numEntities);
+	LOG_DEBUG(LogCategory::ECS, "Component Id: {} of TYPE: {} was added to {} entities", componentId, typeid(TComponent).name(), count);
+}
+
+template <typename TComponent>
+void Registry::AddComponents(Span<const Entity> entities, Span<const TComponent> components) {
+	if (entities.size() != components.size()) {
+		LOG_ERR(LogCategory::ECS, "AddComponents called with {} entities and {} components", entities.size(), components.size());
+		return;
 	}
 
-	TComponent newComponent(std::forward<TArgs>(args)...);
+	AddComponentsWith<TComponent>(entities, [&components](int i) -> const TComponent& { return components[i]; });
+}
+
+template <typename ...TComponents>
+std::vector<Entity> Registry::CreateEntities(int count, const TComponents& ...prototype) {
+	std::vector<Entity> entities;
+	CreateEntitiesInto(count, entities);
 
-	componentPool->Set(entityId, newComponent);
+	(AddComponentsWith<TComponents>(entities, [&prototype](int) -> const TComponents& { return prototype; }), ...);
 
-	// So we are adding a component to an entity
-	// We need to change the signature of our entity
-	entityComponentSignatures[entityId].set(componentId);
-	
-	std::string tname = typeid(TComponent).name();
-	Logger::Log("Component Id: " + std::to_string(componentId) + " of TYPE: " + tname +
-		" was added to entity: " + std::to_string(entityId));
+	return entities;
 }
 
 template <typename TComponent>
@@ -272,20 +1221,15 @@ void Registry::RemoveComponent(Entity entity) {
 	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
 
-	/*if (componentId >= componentPools.size() || !componentPools[componentId]) {
-		return;
+	if (storageMode == StorageMode::Archetypes) {
+		archetypes.RemoveComponent<TComponent>(entityId);
+	} else if (componentId < static_cast<int>(componentPools.size()) && componentPools[componentId]) {
+		componentPools[componentId]->RemoveEntityFromPool(entityId);
 	}
 
-	Pool<TComponent>* componentPool = Pool<TComponent>(componentPools[componentId]);
-	if (entityId >= componentPool->GetSize() || !componentPool[entityId]) {
-		return;
-	}
-
-	componentPool->Remove(entityId);*/
-
-	// For now we leave the memory as is and just set the signature to false
 	entityComponentSignatures[entityId].set(componentId, false);
-	Logger::Log("Component with ID: " + std::to_string(componentId) + " was removed from ENTITYID: " + std::to_string(entityId));
+	QueueRematch(entityId);
+	LOG_DEBUG(LogCategory::ECS, "Component with ID: {} was removed from ENTITYID: {}", componentId, entityId);
 }
 
 template <typename TComponent>
@@ -314,20 +1258,113 @@ TComponent& Registry::GetComponent(Entity entity) const {
 	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
 
-	auto componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+	if (storageMode == StorageMode::Archetypes) {
+		return archetypes.GetComponent<TComponent>(entityId);
+	}
+
+	// We can't index componentPools[componentId][entityId] directly because the pool is stored as an IPool,
+	// but casting the raw pointer is enough. static_pointer_cast would copy the shared_ptr on every access
+	auto componentPool = static_cast<Pool<TComponent>*>(componentPools[componentId].get());
 	return componentPool->Get(entityId);
+}
+
+template <typename TComponent>
+TComponent& Registry::GetMutableComponent(Entity entity) {
+	MarkChanged<TComponent>(entity);
+	return GetComponent<TComponent>(entity);
+}
+
+template <typename TComponent>
+void Registry::MarkChanged(Entity entity) {
+	// Change ticks are only tracked by the pools
+	if (storageMode == StorageMode::Pools) {
+		GetPool<TComponent>()->MarkChanged(entity.GetId(), currentTick);
+	}
+}
+
+template <typename TComponent>
+Pool<TComponent>* Registry::GetPool() const {
+	const auto componentId = Component<TComponent>::GetId();
+
+	if (componentId >= static_cast<int>(componentPools.size())) {
+		return nullptr;
+	}
+
+	return static_cast<Pool<TComponent>*>(componentPools[componentId].get());
+}
+
+template <typename ...TComponents>
+ComponentView<TComponents...> Registry::View() const {
+	return ComponentView<TComponents...>(GetPool<TComponents>()..., &entityGenerations, const_cast<Registry*>(this));
+}
 
-	// Why can't we just do this?????
-	//return componentPools[componentId][entityId];
+template <typename ...TComponents>
+template <typename TComponent>
+ComponentView<TComponents...> ComponentView<TComponents...>::Changed(uint32_t sinceTick) const {
+	return WithFilter(registry->GetPool<TComponent>(), [](const void* pool, int entityId, uint32_t since) {
+		const auto* componentPool = static_cast<const Pool<TComponent>*>(pool);
+		return componentPool->Has(entityId) && componentPool->GetChangedTick(entityId) >= since;
+	}, sinceTick);
+}
+
+template <typename ...TComponents>
+template <typename TComponent>
+ComponentView<TComponents...> ComponentView<TComponents...>::Added(uint32_t sinceTick) const {
+	return WithFilter(registry->GetPool<TComponent>(), [](const void* pool, int entityId, uint32_t since) {
+		const auto* componentPool = static_cast<const Pool<TComponent>*>(pool);
+		return componentPool->Has(entityId) && componentPool->GetAddedTick(entityId) >= since;
+	}, sinceTick);
+}
+
+template <typename ...TComponents, typename TFunc>
+void Registry::Each(TFunc&& func) {
+	EachInRange<TComponents...>(0, EachSize<TComponents...>(), func);
+}
+
+template <typename ...TComponents>
+int Registry::EachSize() const {
+	if (storageMode == StorageMode::Pools) {
+		return View<TComponents...>().SizeHint();
+	}
+
+	return archetypes.EachSize<TComponents...>();
+}
+
+template <typename ...TComponents, typename TFunc>
+void Registry::EachInRange(int first, int last, TFunc&& func) {
+	if (storageMode == StorageMode::Pools) {
+		View<TComponents...>().EachInRange(first, last, func);
+		return;
+	}
+
+	archetypes.EachInRange<TComponents...>(first, last, [this, &func](int entityId, TComponents& ...components) {
+		Entity entity(entityId, entityGenerations[entityId]);
+		entity.registry = this;
+		func(entity, components...);
+	});
+}
+
+template <typename ...TComponents>
+void Registry::FindEntitiesWith(std::vector<Entity>& result) const {
+	Signature signature;
+	(signature.set(Component<TComponents>::GetId()), ...);
+	FindEntities(signature, result);
 }
 
 template <typename TSystem, typename ...TArgs>
 void Registry::AddSystem(TArgs&& ...args) {
 	std::shared_ptr<TSystem> system(std::make_shared<TSystem>(std::forward<TArgs>(args)...));
-	systems.insert(
+	system->SetName(GetDisplayTypeName(typeid(TSystem).name()));
+	const bool isNew = systems.insert(
 		std::make_pair(
 			std::type_index(typeid(TSystem)),
-			system));
+			system)).second;
+	// The existing system stays, systemList must not point at the one that dies with this function
+	if (!isNew) {
+		LOG_WARN(LogCategory::ECS, "System {} was already added, ignoring the second one", system->GetName());
+		return;
+	}
+	systemList.push_back(system.get());
 }
 
 template <typename TSystem>
@@ -336,6 +1373,7 @@ void Registry::RemoveSystem() {
 
 	// maybe 
 	// systems.erase(std::type_index(typeid(TSystem)));
+	systemList.erase(std::find(systemList.begin(), systemList.end(), system->second.get()));
 	systems.erase(system);
 }
 
@@ -354,6 +1392,53 @@ TSystem& Registry::GetSystem() const {
 	return *(std::static_pointer_cast<TSystem>(system->second));
 }
 
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::RecordAddComponent(Entity entity, int deferredIndex, TArgs&& ...args) {
+	static_assert(alignof(TComponent) <= COMMAND_ALIGNMENT, "Component alignment is too large for a command buffer");
+
+	CommandHeader* command = Allocate(CommandType::AddComponent, sizeof(TComponent));
+	command->entity = entity;
+	command->deferredIndex = deferredIndex;
+	command->apply = [](Registry& registry, Entity target, void* payload) {
+		registry.AddComponent<TComponent>(target, std::move(*static_cast<TComponent*>(payload)));
+	};
+	command->destroy = [](void* payload) {
+		static_cast<TComponent*>(payload)->~TComponent();
+	};
+	new (command->GetPayload()) TComponent(std::forward<TArgs>(args)...);
+}
+
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::AddComponent(Entity entity, TArgs&& ...args) {
+	RecordAddComponent<TComponent>(entity, -1, std::forward<TArgs>(args)...);
+}
+
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::AddComponent(DeferredEntity entity, TArgs&& ...args) {
+	RecordAddComponent<TComponent>(Entity(0), entity.index, std::forward<TArgs>(args)...);
+}
+
+template <typename TComponent>
+void CommandBuffer::RemoveComponent(Entity entity) {
+	CommandHeader* command = Allocate(CommandType::RemoveComponent, 0);
+	command->entity = entity;
+	command->apply = [](Registry& registry, Entity target, void*) {
+		registry.RemoveComponent<TComponent>(target);
+	};
+}
+
+template <typename TFunc>
+void CommandBuffer::ForEachCommand(TFunc&& func) {
+	for (int block = 0; block <= currentBlock && block < static_cast<int>(blocks.size()); block++) {
+		size_t offset = 0;
+		while (offset < blocks[block].used) {
+			auto* command = reinterpret_cast<CommandHeader*>(blocks[block].bytes.get() + offset);
+			offset += command->size;
+			func(*command);
+		}
+	}
+}
+
 template <typename TComponent, typename ...TArgs> 
 void Entity::AddComponent(TArgs&& ...args) {
 	registry->AddComponent<TComponent>(*this, std::forward<TArgs>(args)...);
@@ -374,4 +1459,9 @@ TComponent& Entity::GetComponent() const {
 	return registry->GetComponent<TComponent>(*this);
 }
 
+template <typename TComponent>
+TComponent& Entity::GetMutableComponent() const {
+	return registry->GetMutableComponent<TComponent>(*this);
+}
+
 #endif
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include "SystemScheduler.h"
+#include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
+
+SystemScheduler::SystemScheduler(JobSystem& jobSystem) : jobSystem(jobSystem) {
+	LOG_INFO(LogCategory::Systems, "System scheduler running on {} job workers", jobSystem.GetNumWorkers());
+}
+
+void SystemScheduler::Schedule(const System& system, std::function<void()> func) {
+	ScheduleParallel(system, 1, [func = std::move(func)](int, int) { func(); }, 1);
+}
+
+void SystemScheduler::ScheduleParallel(const System& system, int workSize, std::function<void(int first, int last)> func, int grainSize) {
+	Task task;
+	task.scheduler = this;
+	task.index = static_cast<int>(tasks.size());
+	task.system = &system;
+	task.run = std::move(func);
+	task.workSize = workSize;
+	task.grainSize = std::max(grainSize, 1);
+	tasks.push_back(std::move(task));
+}
+
+void SystemScheduler::Run() {
+	if (tasks.empty()) {
+		return;
+	}
+
+	PROFILE_SCOPE("SystemScheduler::Run");
+
+	// Build the dependency graph. Scheduling order decides who goes first when two systems conflict
+	for (int later = 0; later < static_cast<int>(tasks.size()); later++) {
+		for (int earlier = 0; earlier < later; earlier++) {
+			if (tasks[earlier].system->ConflictsWith(*tasks[later].system)) {
+				tasks[earlier].dependents.push_back(later);
+				tasks[later].numDependencies++;
+			}
+		}
+	}
+
+	// Split every task into its ranges up front, tasks doesn't change size until the end of Run
+	// so the jobs can point into it
+	for (auto& task : tasks) {
+		if (task.workSize <= task.grainSize) {
+			task.jobs.push_back({ &SystemScheduler::RunRange, &task, 0, task.workSize, nullptr });
+		} else {
+			for (int first = 0; first < task.workSize; first += task.grainSize) {
+				task.jobs.push_back({ &SystemScheduler::RunRange, &task, first, std::min(first + task.grainSize, task.workSize), nullptr });
+			}
+		}
+		task.remainingRanges = static_cast<int>(task.jobs.size());
+	}
+
+	// Find every root before submitting any, once a task runs it starts counting down its dependents
+	std::vector<int> rootTasks;
+	for (int i = 0; i < static_cast<int>(tasks.size()); i++) {
+		if (tasks[i].numDependencies == 0) {
+			rootTasks.push_back(i);
+		}
+	}
+	for (int root : rootTasks) {
+		SubmitTask(root);
+	}
+
+	// The calling thread runs jobs as well until every task is done
+	jobSystem.Wait(counter);
+
+	lastTimings.clear();
+	for (const auto& task : tasks) {
+		lastTimings.push_back({ task.system, task.endTicks - task.beginTicks, task.busyTicks, static_cast<int>(task.jobs.size()) });
+	}
+
+	tasks.clear();
+}
+
+void SystemScheduler::SubmitTask(int taskIndex) {
+	auto& task = tasks[taskIndex];
+	jobSystem.Run(task.jobs.data(), static_cast<int>(task.jobs.size()), counter);
+}
+
+void SystemScheduler::RunRange(void* data, int first, int last) {
+	Task& task = *static_cast<Task*>(data);
+	SystemScheduler& scheduler = *task.scheduler;
+
+	// Commands recorded by this range are played back in (task, range) order,
+	// whichever thread ends up running it
+	CommandBuffer::SetThreadSortKey((static_cast<uint64_t>(task.index + 1) << 32) | static_cast<uint32_t>(first));
+	const uint64_t beginTicks = Profiler::Now();
+	task.run(first, last);
+	const uint64_t endTicks = Profiler::Now();
+	CommandBuffer::SetThreadSortKey(0);
+
+	// Systems the last range of this task releases. Submitted outside the lock, the job system
+	// runs jobs inline when it has no workers
+	std::vector<int> readyTasks;
+	{
+		std::lock_guard<std::mutex> lock(scheduler.mutex);
+
+		task.beginTicks = task.beginTicks == 0 ? beginTicks : std::min(task.beginTicks, beginTicks);
+		task.endTicks = std::max(task.endTicks, endTicks);
+		task.busyTicks += endTicks - beginTicks;
+
+		if (--task.remainingRanges > 0) {
+			return;
+		}
+
+		for (int dependent : task.dependents) {
+			if (--scheduler.tasks[dependent].numDependencies == 0) {
+				readyTasks.push_back(dependent);
+			}
+		}
+	}
+
+	// This job still counts until it returns, so the counter can't reach zero in between
+	for (int dependent : readyTasks) {
+		scheduler.SubmitTask(dependent);
+	}
+}
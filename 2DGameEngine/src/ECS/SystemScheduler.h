@@ -0,0 +1,83 @@
+#ifndef SYSTEMSCHEDULER_H
+#define SYSTEMSCHEDULER_H
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include "ECS.h"
+#include "../Jobs/JobSystem.h"
+
+// Runs the systems scheduled for a frame as jobs on the JobSystem.
+//
+// Systems declare which components they read and write (ReadsComponent<T> / WritesComponent<T>).
+// Every Run builds a dependency graph from those declarations: a system waits for every system
+// scheduled before it that it conflicts with, everything else runs at the same time.
+// Systems scheduled with ScheduleParallel are also split into ranges of work items
+// (see Registry::EachInRange) so one large system can use every core.
+//
+// Systems must not make structural changes (create/kill entities, add/remove components)
+// directly while they are running under the scheduler, they record them into
+// Registry::GetCommandBuffer() instead.
+class SystemScheduler {
+public:
+	// How long a system took in the last Run, in Profiler::Now ticks
+	struct SystemTiming {
+		const System* system;
+		// First range started to last range finished
+		uint64_t wallTicks;
+		// Sum of the ranges, more than wallTicks when the ranges ran on several threads
+		uint64_t busyTicks;
+		int numRanges;
+	};
+
+private:
+	struct Task {
+		SystemScheduler* scheduler;
+		int index;
+		const System* system;
+		std::function<void(int first, int last)> run;
+		int workSize;
+		int grainSize;
+		// Filled in by Run, one job per range
+		std::vector<Job> jobs;
+		std::vector<int> dependents;
+		int numDependencies = 0;
+		// Guarded by mutex
+		int remainingRanges = 0;
+		uint64_t beginTicks = 0;
+		uint64_t endTicks = 0;
+		uint64_t busyTicks = 0;
+	};
+
+	JobSystem& jobSystem;
+	std::vector<Task> tasks;
+	std::vector<SystemTiming> lastTimings;
+	// Every job of the current Run, dependents are added to it before the job releasing them finishes
+	JobCounter counter;
+
+	// Guards the timings and dependency counts of the tasks
+	std::mutex mutex;
+
+	static void RunRange(void* data, int first, int last);
+	void SubmitTask(int taskIndex);
+public:
+	static constexpr int DEFAULT_GRAIN_SIZE = 1024;
+
+	explicit SystemScheduler(JobSystem& jobSystem);
+	SystemScheduler(const SystemScheduler&) = delete;
+	SystemScheduler& operator =(const SystemScheduler&) = delete;
+
+	// Schedules func() to run once this frame
+	void Schedule(const System& system, std::function<void()> func);
+	// Schedules func(first, last) for ranges of at most grainSize work items covering [0, workSize)
+	void ScheduleParallel(const System& system, int workSize, std::function<void(int first, int last)> func, int grainSize = DEFAULT_GRAIN_SIZE);
+
+	// Runs everything scheduled since the last Run and waits for it to finish
+	void Run();
+
+	int GetNumWorkers() const { return jobSystem.GetNumWorkers(); }
+	// One entry per task of the last Run, in scheduling order
+	const std::vector<SystemTiming>& GetLastTimings() const { return lastTimings; }
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include <atomic>
+#include "EventBus.h"
+#include "../Profiler/Profiler.h"
+
+int IEventType::NextId() {
+	// Event types can be seen for the first time from any thread
+	static std::atomic<int> nextId(0);
+	return nextId++;
+}
+
+void EventBus::Unsubscribe(const void* instance) {
+	for (auto& queue : queues) {
+		if (queue) {
+			queue->Unsubscribe(instance);
+		}
+	}
+}
+
+void EventBus::Dispatch() {
+	PROFILE_SCOPE("EventBus::Dispatch");
+
+	// Subscribers can publish other event types, keep going until a pass finds nothing new
+	bool hasDispatched = true;
+	while (hasDispatched) {
+		hasDispatched = false;
+		// By index, a subscriber publishing a type for the first time grows queues
+		for (size_t i = 0; i < queues.size(); i++) {
+			if (queues[i] && queues[i]->DispatchPending()) {
+				hasDispatched = true;
+			}
+		}
+	}
+}
+
+void EventBus::Clear() {
+	for (auto& queue : queues) {
+		if (queue) {
+			queue->Clear();
+		}
+	}
+}
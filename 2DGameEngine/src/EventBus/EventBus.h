@@ -0,0 +1,218 @@
+#ifndef EVENTBUS_H
+#define EVENTBUS_H
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include "../ECS/ECS.h"
+
+// A free function or a member function bound to an instance, called with a batch of events.
+// Two pointers, no std::function and nothing on the heap
+template <typename TEvent>
+class EventDelegate {
+private:
+	void* instance = nullptr;
+	void (*function)(void* instance, Span<const TEvent> events) = nullptr;
+public:
+	EventDelegate() = default;
+
+	// EventDelegate<KeyPressedEvent>::Create<&KeyboardControlSystem::OnKeyPressed>(this)
+	template <auto Method, typename T>
+	static EventDelegate Create(T* instance) {
+		EventDelegate delegate;
+		delegate.instance = instance;
+		delegate.function = [](void* instance, Span<const TEvent> events) {
+			(static_cast<T*>(instance)->*Method)(events);
+		};
+		return delegate;
+	}
+
+	template <void (*Function)(Span<const TEvent>)>
+	static EventDelegate Create() {
+		EventDelegate delegate;
+		delegate.function = [](void*, Span<const TEvent> events) {
+			Function(events);
+		};
+		return delegate;
+	}
+
+	void operator ()(Span<const TEvent> events) const { function(instance, events); }
+	bool IsBound() const { return function != nullptr; }
+	bool IsBoundTo(const void* other) const { return function != nullptr && instance == other; }
+};
+
+struct IEventType {
+protected:
+	// Hands out the next event type id
+	static int NextId();
+};
+
+template <typename TEvent>
+class EventType: public IEventType {
+public:
+	static int GetId() {
+		static auto id = NextId();
+		return id;
+	}
+};
+
+// Publish / subscribe between engine parts that shouldn't know about each other (input, collisions, damage...).
+//
+// Events are queued per type in a contiguous per frame queue and handed to the subscribers in batches:
+// every subscriber of a type gets one call per Dispatch with a span of all the new events of that type.
+// Systems that would rather pull can read the whole frame's queue with GetEvents.
+// Queues and subscriber lists keep their memory when cleared, after the first frames publishing doesn't allocate.
+// Subscribers may publish, subscribe and unsubscribe while they are handling a batch.
+//
+// Not thread safe: publish, dispatch and clear from one thread at a time. The game publishes input in
+// ProcessInput, dispatches at the start of Update and clears the queues in FinishFrame
+class EventBus {
+private:
+	// Events queued initially per type, the queues grow from there as needed
+	static constexpr size_t INITIAL_CAPACITY = 64;
+
+	class IEventQueue {
+	public:
+		virtual ~IEventQueue() = default;
+		// Delivers the events published since the last call, false if there were none
+		virtual bool DispatchPending() = 0;
+		virtual void Clear() = 0;
+		virtual void Unsubscribe(const void* instance) = 0;
+	};
+
+	template <typename TEvent>
+	class EventQueue: public IEventQueue {
+	public:
+		std::vector<TEvent> events;
+		// Copy of the events being delivered. Subscribers can publish more of this type, which may move events
+		std::vector<TEvent> batch;
+		std::vector<EventDelegate<TEvent>> subscribers;
+		// events before this index were handed to the subscribers already
+		size_t numDispatched = 0;
+		bool isDispatching = false;
+		// Unsubscribed while dispatching, the entries are unbound and erased once the batch is delivered
+		bool hasUnboundSubscribers = false;
+
+		EventQueue() {
+			events.reserve(INITIAL_CAPACITY);
+			batch.reserve(INITIAL_CAPACITY);
+		}
+
+		bool DispatchPending() override {
+			// A subscriber calling Dispatch gets nothing more of the type it is handling
+			if (isDispatching || numDispatched == events.size()) {
+				return false;
+			}
+
+			batch.assign(events.begin() + numDispatched, events.end());
+			numDispatched = events.size();
+
+			// Subscribers added by a subscriber get the next batch, by index because subscribing can grow the vector
+			isDispatching = true;
+			const size_t numSubscribers = subscribers.size();
+			for (size_t i = 0; i < numSubscribers; i++) {
+				const EventDelegate<TEvent> subscriber = subscribers[i];
+				if (subscriber.IsBound()) {
+					subscriber(Span<const TEvent>(batch.data(), batch.size()));
+				}
+			}
+			isDispatching = false;
+
+			if (hasUnboundSubscribers) {
+				subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(), [](const EventDelegate<TEvent>& subscriber) {
+					return !subscriber.IsBound();
+				}), subscribers.end());
+				hasUnboundSubscribers = false;
+			}
+			return true;
+		}
+
+		void Clear() override {
+			events.clear();
+			numDispatched = 0;
+		}
+
+		void Unsubscribe(const void* instance) override {
+			// Erasing would shift the subscribers still waiting for the batch
+			if (isDispatching) {
+				for (auto& subscriber : subscribers) {
+					if (subscriber.IsBoundTo(instance)) {
+						subscriber = EventDelegate<TEvent>();
+						hasUnboundSubscribers = true;
+					}
+				}
+				return;
+			}
+
+			subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(), [instance](const EventDelegate<TEvent>& subscriber) {
+				return subscriber.IsBoundTo(instance);
+			}), subscribers.end());
+		}
+	};
+
+	// vector index = event type id, nullptr for types nobody used on this bus yet
+	std::vector<std::unique_ptr<IEventQueue>> queues;
+
+	template <typename TEvent> EventQueue<TEvent>& GetQueue();
+public:
+	EventBus() = default;
+	EventBus(const EventBus&) = delete;
+	EventBus& operator =(const EventBus&) = delete;
+
+	template <typename TEvent> void Subscribe(EventDelegate<TEvent> delegate);
+	// Subscribes instance->Method, Method takes a Span<const TEvent>
+	template <typename TEvent, auto Method, typename T> void Subscribe(T* instance);
+	// Removes every subscription bound to instance, from every event type
+	void Unsubscribe(const void* instance);
+
+	template <typename TEvent, typename ...TArgs> void Publish(TArgs&& ...args);
+
+	// Hands the events published since the last Dispatch to their subscribers. Events the subscribers
+	// publish, of any type, are delivered in a later batch of the same Dispatch. A subscriber that
+	// publishes its own type on every batch keeps Dispatch from returning
+	void Dispatch();
+	// Every event of this type published since the last Clear, dispatched or not
+	template <typename TEvent> Span<const TEvent> GetEvents() const;
+	// Ends the frame: empties every queue
+	void Clear();
+};
+
+template <typename TEvent>
+EventBus::EventQueue<TEvent>& EventBus::GetQueue() {
+	const int typeId = EventType<TEvent>::GetId();
+	if (typeId >= static_cast<int>(queues.size())) {
+		queues.resize(typeId + 1);
+	}
+	if (!queues[typeId]) {
+		queues[typeId] = std::make_unique<EventQueue<TEvent>>();
+	}
+	return static_cast<EventQueue<TEvent>&>(*queues[typeId]);
+}
+
+template <typename TEvent>
+void EventBus::Subscribe(EventDelegate<TEvent> delegate) {
+	GetQueue<TEvent>().subscribers.push_back(delegate);
+}
+
+template <typename TEvent, auto Method, typename T>
+void EventBus::Subscribe(T* instance) {
+	Subscribe<TEvent>(EventDelegate<TEvent>::template Create<Method>(instance));
+}
+
+template <typename TEvent, typename ...TArgs>
+void EventBus::Publish(TArgs&& ...args) {
+	GetQueue<TEvent>().events.push_back(TEvent{ std::forward<TArgs>(args)... });
+}
+
+template <typename TEvent>
+Span<const TEvent> EventBus::GetEvents() const {
+	const int typeId = EventType<TEvent>::GetId();
+	if (typeId >= static_cast<int>(queues.size()) || !queues[typeId]) {
+		return Span<const TEvent>();
+	}
+	const auto& events = static_cast<const EventQueue<TEvent>&>(*queues[typeId]).events;
+	return Span<const TEvent>(events.data(), events.size());
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef KEYPRESSEDEVENT_H
+#define KEYPRESSEDEVENT_H
+#include <SDL.h>
+
+// Published by Game::ProcessInput for every key down, live or replayed
+struct KeyPressedEvent {
+	SDL_Keycode symbol;
+	// SDL_Keymod flags held with the key
+	Uint16 modifiers;
+	// Generated by the key being held down
+	bool isRepeat;
+};
+
+#endif
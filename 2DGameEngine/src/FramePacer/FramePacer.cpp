@@ -0,0 +1,170 @@
+#include <SDL.h>
+#include <algorithm>
+#include <cmath>
+#include "FramePacer.h"
+#include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+// Windows 10 1803 and later, older SDKs don't define it
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <time.h>
+#include <cerrno>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define CPU_PAUSE() _mm_pause()
+#else
+#define CPU_PAUSE() ((void)0)
+#endif
+
+// How quickly the overshoot estimate follows the sleeps, per sleep
+static constexpr double OVERSHOOT_SMOOTHING = 0.1;
+
+FramePacer::FramePacer() {
+	frequency = SDL_GetPerformanceFrequency();
+
+#ifdef _WIN32
+	// Plain waitable timers and Sleep round up to the timer interrupt (up to 15.6 ms), the high resolution one doesn't
+	waitableTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!waitableTimer) {
+		waitableTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	}
+#endif
+}
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+	if (waitableTimer) {
+		CloseHandle(static_cast<HANDLE>(waitableTimer));
+	}
+#endif
+}
+
+void FramePacer::SetFrameRate(int framesPerSecond) {
+	periodTicks = framesPerSecond > 0 ? frequency / framesPerSecond : 0;
+	nextDeadline = 0;
+}
+
+void FramePacer::Sleep(double seconds) {
+#ifdef _WIN32
+	if (waitableTimer) {
+		// Negative due times are relative, in 100 ns units
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -static_cast<LONGLONG>(seconds * 1e7);
+		if (SetWaitableTimer(static_cast<HANDLE>(waitableTimer), &dueTime, 0, nullptr, nullptr, FALSE)) {
+			WaitForSingleObject(static_cast<HANDLE>(waitableTimer), INFINITE);
+			return;
+		}
+	}
+	::Sleep(static_cast<DWORD>(seconds * 1000.0));
+#else
+	timespec remaining;
+	remaining.tv_sec = static_cast<time_t>(seconds);
+	remaining.tv_nsec = static_cast<long>((seconds - remaining.tv_sec) * 1e9);
+#ifdef __APPLE__
+	while (nanosleep(&remaining, &remaining) == EINTR) {
+	}
+#else
+	while (clock_nanosleep(CLOCK_MONOTONIC, 0, &remaining, &remaining) == EINTR) {
+	}
+#endif
+#endif
+}
+
+void FramePacer::Wait() {
+	if (!IsEnabled()) {
+		return;
+	}
+
+	PROFILE_SCOPE("FramePacer::Wait");
+
+	uint64_t now = SDL_GetPerformanceCounter();
+	if (nextDeadline == 0) {
+		nextDeadline = now + periodTicks;
+		return;
+	}
+
+	if (now >= nextDeadline) {
+		const uint64_t lateTicks = now - nextDeadline;
+		RecordError(TicksToSeconds(lateTicks));
+		numLateFrames += TicksToSeconds(lateTicks) > LATE_FRAME_SECONDS ? 1 : 0;
+
+		// More than a frame behind: start over from now instead of rushing the next frames out to catch up
+		nextDeadline = lateTicks > periodTicks ? now + periodTicks : nextDeadline + periodTicks;
+		return;
+	}
+
+	// Sleep for all but the part the OS would likely oversleep anyway
+	const double spinSeconds = std::min(std::max(sleepOvershootSeconds * 1.5 + MIN_SPIN_SECONDS, MIN_SPIN_SECONDS), MAX_SPIN_SECONDS);
+	const double remainingSeconds = TicksToSeconds(nextDeadline - now);
+	if (remainingSeconds > spinSeconds) {
+		const double requestedSeconds = remainingSeconds - spinSeconds;
+		const uint64_t sleepBegin = now;
+		Sleep(requestedSeconds);
+		now = SDL_GetPerformanceCounter();
+
+		const double sleptSeconds = TicksToSeconds(now - sleepBegin);
+		sleepOvershootSeconds += (std::max(sleptSeconds - requestedSeconds, 0.0) - sleepOvershootSeconds) * OVERSHOOT_SMOOTHING;
+		totalSleepSeconds += sleptSeconds;
+	}
+
+	const uint64_t spinBegin = now;
+	while (now < nextDeadline) {
+		CPU_PAUSE();
+		now = SDL_GetPerformanceCounter();
+	}
+	totalSpinSeconds += TicksToSeconds(now - spinBegin);
+
+	RecordError(TicksToSeconds(now - nextDeadline));
+	nextDeadline += periodTicks;
+}
+
+void FramePacer::RecordError(double errorSeconds) {
+	const double error = errorSeconds * 1e6;
+	numFrames++;
+	const double delta = error - errorMean;
+	errorMean += delta / numFrames;
+	errorM2 += delta * (error - errorMean);
+	errorMax = std::max(errorMax, error);
+}
+
+PacingStats FramePacer::GetStats() const {
+	PacingStats stats;
+	stats.numFrames = numFrames;
+	stats.meanErrorMicroseconds = errorMean;
+	stats.maxErrorMicroseconds = errorMax;
+	stats.stdDevErrorMicroseconds = numFrames > 1 ? std::sqrt(errorM2 / (numFrames - 1)) : 0.0;
+	stats.numLateFrames = numLateFrames;
+	stats.meanSleepMicroseconds = numFrames > 0 ? totalSleepSeconds * 1e6 / numFrames : 0.0;
+	stats.meanSpinMicroseconds = numFrames > 0 ? totalSpinSeconds * 1e6 / numFrames : 0.0;
+	return stats;
+}
+
+void FramePacer::ResetStats() {
+	numFrames = 0;
+	errorMean = 0.0;
+	errorM2 = 0.0;
+	errorMax = 0.0;
+	numLateFrames = 0;
+	totalSleepSeconds = 0.0;
+	totalSpinSeconds = 0.0;
+}
+
+void FramePacer::LogStats() const {
+	if (!IsEnabled() || numFrames == 0) {
+		return;
+	}
+
+	const PacingStats stats = GetStats();
+	LOG_INFO(LogCategory::Game, "Frame pacing over {} frames: error mean {} us, std dev {} us, max {} us, {} late frames, sleep {} us + spin {} us per frame",
+		stats.numFrames, stats.meanErrorMicroseconds, stats.stdDevErrorMicroseconds, stats.maxErrorMicroseconds,
+		stats.numLateFrames, stats.meanSleepMicroseconds, stats.meanSpinMicroseconds);
+}
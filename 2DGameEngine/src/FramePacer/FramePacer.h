@@ -0,0 +1,77 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <cstdint>
+
+// Pacing error of the frames since the last ResetStats, in microseconds.
+// The error of a frame is how late it started compared to its deadline
+struct PacingStats {
+	int numFrames;
+	double meanErrorMicroseconds;
+	double maxErrorMicroseconds;
+	double stdDevErrorMicroseconds;
+	// Frames whose work alone took longer than a frame, nothing the pacer could do about those
+	int numLateFrames;
+	// Time spent sleeping and spinning per paced frame
+	double meanSleepMicroseconds;
+	double meanSpinMicroseconds;
+};
+
+// Holds the game loop to a frame rate.
+// Deadlines are kept on the SDL_GetPerformanceCounter clock, one period apart, so a frame that runs
+// a little long doesn't push every later frame back. Waiting is two phases: the OS sleeps until shortly
+// before the deadline (clock_nanosleep, or a high resolution waitable timer on Windows) and the last
+// stretch is spun, because sleeps routinely overshoot by more than the jitter we are trying to remove.
+// How early to stop sleeping adapts to how much the sleeps of this machine actually overshoot.
+class FramePacer {
+public:
+	// Bounds of the spin phase
+	static constexpr double MIN_SPIN_SECONDS = 0.0001;
+	static constexpr double MAX_SPIN_SECONDS = 0.002;
+	// A frame this late (work included) counts in numLateFrames
+	static constexpr double LATE_FRAME_SECONDS = 0.001;
+
+private:
+	uint64_t frequency = 0;
+	uint64_t periodTicks = 0;
+	uint64_t nextDeadline = 0;
+
+	// Moving average of how much longer sleeps take than requested
+	double sleepOvershootSeconds = 0.0005;
+
+#ifdef _WIN32
+	void* waitableTimer = nullptr;
+#endif
+
+	// Welford's running mean / variance of the errors
+	int numFrames = 0;
+	double errorMean = 0.0;
+	double errorM2 = 0.0;
+	double errorMax = 0.0;
+	int numLateFrames = 0;
+	double totalSleepSeconds = 0.0;
+	double totalSpinSeconds = 0.0;
+
+	void Sleep(double seconds);
+	void RecordError(double errorSeconds);
+	double TicksToSeconds(uint64_t ticks) const { return static_cast<double>(ticks) / frequency; }
+public:
+	FramePacer();
+	~FramePacer();
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator =(const FramePacer&) = delete;
+
+	// 0 turns pacing off, Wait returns straight away then
+	void SetFrameRate(int framesPerSecond);
+	bool IsEnabled() const { return periodTicks > 0; }
+
+	// Blocks until the next frame is due
+	void Wait();
+
+	PacingStats GetStats() const;
+	void ResetStats();
+	// Logs GetStats
+	void LogStats() const;
+};
+
+#endif
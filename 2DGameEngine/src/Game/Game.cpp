@@ -1,34 +1,64 @@
 #include <glm/glm.hpp>
 #include <SDL_image.h>
 #include <fstream>
+#include <cstdio>
+#include <cmath>
 #include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
 #include "Game.h"
 #include "../ECS/ECS.h"
 #include "../Components/TransformComponent.h"
 #include "../Components/RigidBodyComponent.h"
+#include "../Components/PreviousTransformComponent.h"
+#include "../Events/KeyPressedEvent.h"
 #include "../Systems/MovementSystem.h"
+#include "../Systems/TransformHistorySystem.h"
 #include "../Systems/RenderSystem.h"
+#include "SimulationThread.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
 #define DEBUG
 
-Game::Game() {
+Game::Game(const GameOptions& options) : options(options) {
 	isRunning = false;
-	Logger::Log("Game constructor called");
+	LOG_INFO(LogCategory::Game, "Game constructor called");
+	jobSystem = std::make_unique<JobSystem>();
+	eventBus = std::make_unique<EventBus>();
 	registry = std::make_unique<Registry>();
-	assetStore = std::make_unique<AssetStore>();
+	registry->SetJobSystem(jobSystem.get());
+	registry->SetEventBus(eventBus.get());
+	systemScheduler = std::make_unique<SystemScheduler>(*jobSystem);
+	assetStore = std::make_unique<AssetStore>(jobSystem.get());
+	performanceOverlay = std::make_unique<PerformanceOverlay>();
+	inputLayer = std::make_unique<InputLayer>();
+	statsExporter = std::make_unique<StatsExporter>();
+	framePacer = std::make_unique<FramePacer>();
+	renderSnapshots = std::make_unique<RenderSnapshotBuffer>();
 }
 
 Game::~Game() {
-	Logger::Log("Game destructor called");
+	LOG_INFO(LogCategory::Game, "Game destructor called");
 }
 
 void Game::Initialize() {
+	if (options.isHeadless) {
+		// Build servers have no display and often no audio device either, only bring up what the simulation uses.
+		// The dummy video driver keeps anything that touches video from looking for a display
+		SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+		if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS)) {
+			LOG_ERR(LogCategory::Game, "Error initializing SDL: {}", SDL_GetError());
+			return;
+		}
+
+		LOG_INFO(LogCategory::Game, "Running headless with a fixed dt of {} s", options.fixedDeltaTime);
+		isRunning = true;
+		return;
+	}
+
 	if (SDL_Init(SDL_INIT_EVERYTHING)) {
-		Logger::Err("Error initializing SDL");
-		Logger::Err(SDL_GetError());
+		LOG_ERR(LogCategory::Game, "Error initializing SDL: {}", SDL_GetError());
 		return;
 	}
 	// Better to not scale the window to the users display.
@@ -45,8 +75,7 @@ void Game::Initialize() {
 #else
 	SDL_DisplayMode displayMode;
 	if (SDL_GetCurrentDisplayMode(0, &displayMode) != 0) {
-		Logger::Err("Error getting SDL display mode");
-		Logger::Err(SDL_GetError());
+		LOG_ERR(LogCategory::Game, "Error getting SDL display mode: {}", SDL_GetError());
 	}
 	windowWidth = displayMode.w;
 	windowHeight = displayMode.h;
@@ -65,8 +94,7 @@ void Game::Initialize() {
 		0);
 
 	if (!window) {
-		Logger::Err("Error creating SDL window");
-		Logger::Err(SDL_GetError());
+		LOG_ERR(LogCategory::Game, "Error creating SDL window: {}", SDL_GetError());
 		return;
 	}
 
@@ -81,28 +109,52 @@ void Game::Initialize() {
 	// https://wiki.libsdl.org/SDL2/SDL_CreateRenderer
 	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 	if (!renderer) {
-		Logger::Err("Error Creating SDL Renderer");
-		Logger::Err(SDL_GetError());
+		LOG_ERR(LogCategory::Game, "Error Creating SDL Renderer: {}", SDL_GetError());
 		return;
 	}
 	// Set the renderer's draw color
 	// If this is commented out this means its set in the render function as its changing frame by frame
 	SDL_SetRenderDrawColor(renderer, 21, 21, 21, 255);
 
+	performanceOverlay->Initialize(renderer, windowWidth, windowHeight);
+
+	// In debug we render at a fixed 60 fps, otherwise uncapped (vsync permitting)
+	int frameRateCap = options.frameRateCap;
+	if (frameRateCap < 0) {
+#ifdef DEBUG
+		frameRateCap = FPS;
+#else
+		frameRateCap = 0;
+#endif
+	}
+	framePacer->SetFrameRate(frameRateCap);
+
 	isRunning = true;
 }
 
 void Game::Destroy() {
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
+	statsExporter->Close();
+	performanceOverlay->Destroy();
+	if (renderer) {
+		SDL_DestroyRenderer(renderer);
+	}
+	if (window) {
+		SDL_DestroyWindow(window);
+	}
 	SDL_Quit();
 }
 
 void Game::LoadLevel(int level) {
-	// Add Assets
-	assetStore->AddTexture(renderer, "tank-tiger-right", "./assets/images/tank-tiger-right.png");
-	assetStore->AddTexture(renderer, "truck-ford-right", "./assets/images/truck-ford-right.png");
-	assetStore->AddTexture(renderer, "tilemap-image", "./assets/tilemaps/jungle.png");
+	PROFILE_SCOPE("Game::LoadLevel");
+
+	// Add Assets, textures are only needed when something is drawn
+	if (renderer) {
+		assetStore->AddTextures(renderer, {
+			{ "tank-tiger-right", "./assets/images/tank-tiger-right.png" },
+			{ "truck-ford-right", "./assets/images/truck-ford-right.png" },
+			{ "tilemap-image", "./assets/tilemaps/jungle.png" }
+		});
+	}
 
 	// Load the tilemap
 	int tileSize = 32;
@@ -113,25 +165,35 @@ void Game::LoadLevel(int level) {
 	std::fstream mapFile;
 	mapFile.open("./assets/tilemaps/jungle.map");
 
+	// Read the whole map first so the tiles can be created in one batch
+	std::vector<TransformComponent> tileTransforms;
+	std::vector<SpriteComponent> tileSprites;
+	tileTransforms.reserve(mapNumRows * mapNumCols);
+	tileSprites.reserve(mapNumRows * mapNumCols);
+
 	for (int y = 0; y < mapNumRows; y++) {
 		for (int x = 0; x < mapNumCols; x++) {
 			char ch;
 			mapFile.get(ch);
-			int srcRectY = std::atoi(&ch) * tileSize;
+			int srcRectY = (ch - '0') * tileSize;
 			mapFile.get(ch);
-			int srcRectX = std::atoi(&ch) * tileSize;
+			int srcRectX = (ch - '0') * tileSize;
 			mapFile.ignore();
 
-			Entity tile = registry->CreateEntity();
-			tile.AddComponent<TransformComponent>(glm::vec2(x * tileScale * tileSize, y * tileScale * tileSize), glm::vec2(tileScale, tileScale), 0);
-			tile.AddComponent<SpriteComponent>("tilemap-image", tileSize, tileSize, srcRectX, srcRectY, 0);
+			tileTransforms.emplace_back(glm::vec2(x * tileScale * tileSize, y * tileScale * tileSize), glm::vec2(tileScale, tileScale), 0);
+			tileSprites.emplace_back("tilemap-image", tileSize, tileSize, srcRectX, srcRectY, 0);
 		}
 	}
 
 	mapFile.close();
 
+	std::vector<Entity> tiles = registry->CreateEntities(static_cast<int>(tileTransforms.size()));
+	registry->AddComponents<TransformComponent>(tiles, tileTransforms);
+	registry->AddComponents<SpriteComponent>(tiles, tileSprites);
+
 
 	// Add the systems that need to be processed in our game
+	registry->AddSystem<TransformHistorySystem>();
 	registry->AddSystem<MovementSystem>();
 	registry->AddSystem<RenderSystem>();
 
@@ -149,12 +211,14 @@ void Game::LoadLevel(int level) {
 	tank.AddComponent<TransformComponent>(glm::vec2(10.0, 10.0), glm::vec2(1.0, 1.0), 0.0);
 	tank.AddComponent<RigidBodyComponent>(glm::vec2(40.0, 0.0));
 	tank.AddComponent<SpriteComponent>("tank-tiger-right", 32, 32, 0, 0, 1);
+	tank.AddComponent<PreviousTransformComponent>(tank.GetComponent<TransformComponent>());
 
 	Entity truck = registry->CreateEntity();
 	//registry->AddComponent<TransformComponent>(truck);
 	truck.AddComponent<TransformComponent>(glm::vec2(2.0, 10.0));
 	truck.AddComponent<RigidBodyComponent>(glm::vec2(2.0, 10.0));
 	truck.AddComponent<SpriteComponent>("truck-ford-right", 32, 32, 0, 0, 1);
+	truck.AddComponent<PreviousTransformComponent>(truck.GetComponent<TransformComponent>());
 	//truck.RemoveComponent<TransformComponent>();
 }
 
@@ -163,17 +227,161 @@ void Game::Setup() {
 }
 
 void Game::Run() {
+	Profiler::SetThreadName("Main");
 	Setup();
+
+	if (!options.replayInputPath.empty()) {
+		inputLayer->StartReplay(options.replayInputPath);
+	} else if (!options.recordInputPath.empty()) {
+		inputLayer->StartRecording(options.recordInputPath);
+	}
+
+	if (!options.statsPageName.empty()) {
+		statsExporter->Open(options.statsPageName);
+	}
+
+	headlessStartCounter = SDL_GetPerformanceCounter();
+	headlessReportCounter = headlessStartCounter;
+
+	// SDL stays on the main thread: it reads the input and draws. When there is something to draw
+	// the simulation runs on a thread of its own, one frame ahead of the frame being drawn
+	const bool isPipelined = options.isPipelined && renderer;
+	std::unique_ptr<SimulationThread> simulationThread;
+	if (isPipelined) {
+		simulationThread = std::make_unique<SimulationThread>([this]() { Update(); });
+	}
+	bool isSimulating = false;
+
 	while (isRunning) {
-		ProcessInput();
-		Update();
+		// If we are too fast waste some time - this caps the framerate.
+		// Before reading input so the frame works with the freshest input there is
+		framePacer->Wait();
+
+		Profiler::BeginFrame();
+		if (isPipelined) {
+			// The frame simulated while the last one was drawn has to be done before it is drawn
+			// and before the next one starts
+			if (isSimulating) {
+				simulationThread->Wait();
+				isSimulating = false;
+				FinishFrame();
+			}
+
+			if (isRunning) {
+				inputLayer->BeginFrame();
+				ProcessInput();
+				simulationThread->Kick();
+				isSimulating = true;
+				frameCount++;
+			}
+		} else {
+			inputLayer->BeginFrame();
+			ProcessInput();
+			Update();
+			frameCount++;
+			FinishFrame();
+		}
+
 		Render();
+		Profiler::EndFrame();
+
+		if (options.maxFrames > 0 && frameCount >= options.maxFrames) {
+			isRunning = false;
+		}
+
+		if (options.isHeadless) {
+			ReportHeadlessFrameRate(!isRunning);
+		}
+	}
+
+	if (isSimulating) {
+		simulationThread->Wait();
+		FinishFrame();
 	}
+	simulationThread.reset();
+
+	framePacer->LogStats();
+
+	if (inputLayer->GetMode() != InputLayer::Mode::Live) {
+		LogSimulationChecksum();
+		inputLayer->Stop();
+	}
+}
+
+// Closes the frame the simulation just finished: its input, its render snapshot and everything that reads the engine.
+// Runs on the main thread while the simulation is idle
+void Game::FinishFrame() {
+	inputLayer->EndFrame();
+	eventBus->Clear();
+	renderSnapshots->Swap();
+
+	statsExporter->EndFrame(frameCount, *registry, *systemScheduler, *assetStore);
+	performanceOverlay->RecordPacing(framePacer->GetStats());
+	performanceOverlay->Build(*registry, *systemScheduler, *assetStore);
+
+	if (inputLayer->IsReplayFinished()) {
+		LOG_INFO(LogCategory::Input, "Replay finished after {} frames", inputLayer->GetReplayFrame());
+		isRunning = false;
+	}
+}
+
+// FNV-1a over every transform. A replay of a recording ends with the same checksum as the recording
+// as long as the simulation is deterministic, comparing the two is the quickest way to find out if it still is
+void Game::LogSimulationChecksum() {
+	uint64_t checksum = 14695981039346656037ull;
+	auto hash = [&checksum](const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			checksum = (checksum ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+
+	registry->Each<TransformComponent>([&hash](Entity entity, TransformComponent& transform) {
+		const int id = entity.GetId();
+		hash(&id, sizeof(id));
+		hash(&transform.position, sizeof(transform.position));
+		hash(&transform.scale, sizeof(transform.scale));
+		hash(&transform.rotation, sizeof(transform.rotation));
+	});
+
+	char checksumText[17];
+	std::snprintf(checksumText, sizeof(checksumText), "%016llx", static_cast<unsigned long long>(checksum));
+	LOG_INFO(LogCategory::Game, "Simulation checksum after {} frames: {}", frameCount, checksumText);
+}
+
+// Logs the frames per second since the last report, and over the whole run once the game stops.
+// Simulated seconds per second shows how much faster than real time the simulation runs
+void Game::ReportHeadlessFrameRate(bool isFinal) {
+	const uint64_t now = SDL_GetPerformanceCounter();
+	const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+
+	if (isFinal) {
+		const double seconds = (now - headlessStartCounter) / frequency;
+		const double framesPerSecond = seconds > 0.0 ? frameCount / seconds : 0.0;
+		LOG_INFO(LogCategory::Game, "Headless run: {} frames in {} s, {} frames/s, {} simulated s per s",
+			frameCount, seconds, framesPerSecond, framesPerSecond * options.fixedDeltaTime);
+		return;
+	}
+
+	const double seconds = (now - headlessReportCounter) / frequency;
+	if (seconds * 1000.0 < HEADLESS_REPORT_MILLISECONDS) {
+		return;
+	}
+
+	const double framesPerSecond = (frameCount - headlessReportFrame) / seconds;
+	LOG_INFO(LogCategory::Game, "Headless: {} frames/s, {} simulated s per s, {} frames so far",
+		framesPerSecond, framesPerSecond * options.fixedDeltaTime, frameCount);
+	headlessReportCounter = now;
+	headlessReportFrame = frameCount;
 }
 
 void Game::ProcessInput() {
+	PROFILE_SCOPE("Game::ProcessInput");
+
+	// Live SDL events, or the recorded ones during a replay
 	SDL_Event event;
-	while (SDL_PollEvent(&event)) {
+	while (inputLayer->PollEvent(event)) {
+		performanceOverlay->ProcessEvent(event);
 		switch (event.type) {
 		case SDL_QUIT:
 			isRunning = false;
@@ -183,17 +391,24 @@ void Game::ProcessInput() {
 			//Logger::Log(" Current mouse position " + event.motion.x + " " + event.motion.y);
 			break;
 		case SDL_KEYDOWN:
-			Logger::Log("KEY PRESS.");
-			// TODO(yudi): This does not work as event.key.keysym.sym is not a string
-			//Logger::Log(" Current key pressed: " + event.key.keysym.sym);
+			if (event.key.keysym.sym == SDLK_F1) {
+				performanceOverlay->Toggle();
+			}
+			// Write the next couple of seconds of profiler zones out for chrome://tracing
+			if (event.key.keysym.sym == SDLK_F9) {
+				Profiler::CaptureFrames(PROFILE_CAPTURE_FRAMES, "profile.json");
+			}
+			// Typing into the overlay (the log filter) isn't game input
+			if (performanceOverlay->IsCapturingKeyboard()) {
+				break;
+			}
+			eventBus->Publish<KeyPressedEvent>(event.key.keysym.sym, event.key.keysym.mod, event.key.repeat != 0);
 			if (event.key.keysym.sym == SDLK_ESCAPE) {
 				isRunning = false;
 			}
 			break;
 		case SDL_KEYUP:
-			Logger::Log("KEY RELEASED.");
-			// TODO(yudi): This does not work as event.key.keysym.sym is not a string
-			//Logger::Log(" Current key released: " + event.key.keysym.sym);
+			LOG_DEBUG(LogCategory::Input, "KEY RELEASED: {}", SDL_GetKeyName(event.key.keysym.sym));
 			break;
 			/*default:
 				std::cout << "Unhandled event" << std::endl;
@@ -204,45 +419,98 @@ void Game::ProcessInput() {
 }
 
 void Game::Update() {
-	// If we are too fast waste some time - this caps the framerate
-	// Commenting this out results in us running at uncapped FPS
-#ifdef DEBUG
-	int timeToWait = MILLISECONDS_PER_FRAME - (SDL_GetTicks() - millisecsPreviousFrame);
-	if (timeToWait > 0 && timeToWait <= MILLISECONDS_PER_FRAME) {
-		/*
-		The function SDL_Delay is not incredibly accurate, since the call of SDL_Delay itself takes some time to execute.
-		For example, SDL_Delay will never work at a finer resolution than what the OS's scheduler offers.
-		In the 90's a normal Linux scheduler had a 10 millisecond resolution, which meant SDL_Delay would sleep for at least ten times longer than requested.
-		Modern Linux distros have a 1ms resolution, but the underlying idea still holds.
-		And load is also a factor, meaning that if a system is heavily loaded, we might sleep for hundreds of milliseconds.
-		*/
-		SDL_Delay(timeToWait);
+	PROFILE_SCOPE("Game::Update");
+	const uint64_t updateBegin = Profiler::Now();
+
+	// Number of seconds elapsed since the last frame.
+	// Headless runs count every frame as the same amount so a run does the same work however fast the machine is.
+	// A replay uses the dt that was recorded
+	const uint64_t frameCounter = SDL_GetPerformanceCounter();
+	const double measuredDeltaTime = previousFrameCounter == 0 ? 0.0 :
+		static_cast<double>(frameCounter - previousFrameCounter) / SDL_GetPerformanceFrequency();
+	previousFrameCounter = frameCounter;
+	const double deltaTime = inputLayer->GetDeltaTime(options.isHeadless ? options.fixedDeltaTime : measuredDeltaTime);
+
+	// Input published by ProcessInput reaches its subscribers once per frame, before the first step
+	eventBus->Dispatch();
+
+	// The simulation only ever steps by stepTime, whatever the frame rate.
+	// Frame time is banked in the accumulator and spent in whole steps, what's left over
+	// is how far rendering has to interpolate towards the next step
+	const double stepTime = 1.0 / options.tickRate;
+	accumulator += deltaTime;
+	int numSteps = 0;
+	while (accumulator >= stepTime && numSteps < options.maxStepsPerFrame) {
+		Simulate(stepTime);
+		accumulator -= stepTime;
+		numSteps++;
+	}
+
+	// After a hitch (or when steps cost more than they simulate) catching up on everything would only make
+	// the next frame longer still. Let the simulation fall behind real time instead
+	if (accumulator >= stepTime) {
+		LOG_DEBUG(LogCategory::Game, "Simulation fell {} steps behind, skipping them", static_cast<int>(accumulator / stepTime));
+		accumulator = std::fmod(accumulator, stepTime);
+	}
+	interpolationAlpha = accumulator / stepTime;
+
+	if (renderer) {
+		registry->GetSystem<RenderSystem>().BuildSnapshot(*registry, *assetStore, interpolationAlpha, renderSnapshots->GetBack());
 	}
-#endif
 
-	// Number of seconds elapsed since the last frame
-	double deltaTime = (SDL_GetTicks() - millisecsPreviousFrame) / 1000.f;
+	const uint64_t updateTicks = Profiler::Now() - updateBegin;
+	performanceOverlay->RecordUpdate(deltaTime, updateTicks);
+	statsExporter->RecordUpdate(updateTicks);
+}
 
-	// Store the current frame time
-	millisecsPreviousFrame = SDL_GetTicks();
+// One fixed step of the simulation
+void Game::Simulate(double stepTime) {
+	PROFILE_SCOPE("Game::Simulate");
 
 	// Ask all simulation systems to update
-	registry->GetSystem<MovementSystem>().Update(deltaTime);
-	
+	// The scheduler runs systems that don't touch the same components at the same time
+	// and splits the large ones into entity ranges across the worker threads.
+	// TransformHistorySystem reads the transforms MovementSystem writes, so it runs first
+	auto& transformHistorySystem = registry->GetSystem<TransformHistorySystem>();
+	systemScheduler->ScheduleParallel(transformHistorySystem, transformHistorySystem.GetWorkSize(*registry),
+		[this, &transformHistorySystem](int first, int last) {
+			transformHistorySystem.Update(*registry, first, last);
+		});
+
+	auto& movementSystem = registry->GetSystem<MovementSystem>();
+	systemScheduler->ScheduleParallel(movementSystem, movementSystem.GetWorkSize(*registry),
+		[this, &movementSystem, stepTime](int first, int last) {
+			movementSystem.Update(*registry, stepTime, first, last);
+		});
+	systemScheduler->Run();
+
 	// Update the entities in the registry
 	registry->Update();
 }
 
 
 void Game::Render() {
+	if (options.isHeadless) {
+		return;
+	}
+
 	// If this is commented out this is now being set once in the init function since it shouldn't change frame by frame
 	//SDL_SetRenderDrawColor(renderer, 21, 21, 21, 255);
 
+	PROFILE_SCOPE("Game::Render");
+
 	// It's recommended to clear the rederer before redrawing the current frame
 	SDL_RenderClear(renderer);
 
-	// Ask all the render system to render
-	registry->GetSystem<RenderSystem>().Render(renderer, assetStore);
+	// Draw the last finished frame. Only the snapshot is read, the simulation may be busy with the next frame
+	const uint64_t renderBegin = Profiler::Now();
+	RenderSystem::Submit(renderSnapshots->GetFront(), renderer);
+	const uint64_t renderTicks = Profiler::Now() - renderBegin;
+	performanceOverlay->RecordRender(renderTicks);
+	statsExporter->RecordRender(renderTicks);
+
+	// Drawn last so it sits on top of the game, returns straight away while hidden (F1)
+	performanceOverlay->Render();
 	
 	// TODO: Render game objects.. 
 	SDL_RenderPresent(renderer);
@@ -3,22 +3,79 @@
 #include <SDL.h>
 #include <memory>
 #include "../ECS/ECS.h"
+#include "../ECS/SystemScheduler.h"
+#include "../Jobs/JobSystem.h"
+#include "../EventBus/EventBus.h"
 #include "../AssetStore/AssetStore.h"
+#include "../PerformanceOverlay/PerformanceOverlay.h"
+#include "../Input/InputLayer.h"
+#include "../Telemetry/StatsExporter.h"
+#include "../FramePacer/FramePacer.h"
+#include "../Renderer/RenderSnapshot.h"
 
 const int FPS = 60;
-const int MILLISECONDS_PER_FRAME = 1000 / FPS;
+// Frames written out when a profiler capture is started with F9
+const int PROFILE_CAPTURE_FRAMES = 120;
+// Simulation steps per second
+const int TICK_RATE = 60;
+// Most simulation steps a frame catches up on, a frame that falls further behind slows the simulation down instead
+const int MAX_STEPS_PER_FRAME = 5;
+// How often a headless run logs its frame rate
+const int HEADLESS_REPORT_MILLISECONDS = 5000;
+
+// Set from the command line in main
+struct GameOptions {
+	// No window, no renderer and no frame cap: every frame counts as fixedDeltaTime seconds and they run as fast as they can
+	bool isHeadless = false;
+	double fixedDeltaTime = 1.0 / FPS;
+	// The simulation always steps by 1 / tickRate seconds, however long frames take
+	int tickRate = TICK_RATE;
+	int maxStepsPerFrame = MAX_STEPS_PER_FRAME;
+	// Simulate on a thread of its own, overlapping the drawing of the previous frame. Only with a renderer
+	bool isPipelined = true;
+	// Frames per second the loop is held to, 0 for uncapped. -1 picks FPS in DEBUG builds and uncapped otherwise
+	int frameRateCap = -1;
+	// Stop after this many frames, 0 runs until the game is quit
+	int maxFrames = 0;
+	// Write every frame's input and dt to this file / play them back from it, see InputLayer
+	std::string recordInputPath;
+	std::string replayInputPath;
+	// Shared memory page the engine counters are published to, empty for none. See StatsPage
+	std::string statsPageName;
+};
 
 class Game {
 private:
 	bool isRunning;
-	SDL_Window* window;
-	SDL_Renderer* renderer;
-	int millisecsPreviousFrame = 0;
+	GameOptions options;
+	SDL_Window* window = nullptr;
+	SDL_Renderer* renderer = nullptr;
+	// SDL_GetPerformanceCounter at the start of the last Update
+	uint64_t previousFrameCounter = 0;
+	// Seconds of frame time not simulated yet, always less than one step after Update
+	double accumulator = 0.0;
+	// accumulator / step time, how far Render is between the last two steps
+	double interpolationAlpha = 1.0;
+	int frameCount = 0;
+	// Headless frame rate reporting, SDL_GetPerformanceCounter ticks
+	uint64_t headlessStartCounter = 0;
+	uint64_t headlessReportCounter = 0;
+	int headlessReportFrame = 0;
+	// Declared first so it is destroyed last, everything below may have jobs running on it
+	std::unique_ptr<JobSystem> jobSystem;
+	std::unique_ptr<EventBus> eventBus;
 	std::unique_ptr<Registry> registry;
+	std::unique_ptr<SystemScheduler> systemScheduler;
 	std::unique_ptr<AssetStore> assetStore;
+	std::unique_ptr<PerformanceOverlay> performanceOverlay;
+	std::unique_ptr<InputLayer> inputLayer;
+	std::unique_ptr<StatsExporter> statsExporter;
+	std::unique_ptr<FramePacer> framePacer;
+	// Written by Update, drawn by Render
+	std::unique_ptr<RenderSnapshotBuffer> renderSnapshots;
 
 public:
-	Game();
+	Game(const GameOptions& options = GameOptions());
 	~Game();
 	void Initialize();
 	void Destroy();
@@ -26,8 +83,12 @@ public:
 	void Setup();
 	void ProcessInput();
 	void Update();
+	void Simulate(double stepTime);
+	void FinishFrame();
 	void Render();
 	void LoadLevel(int level);
+	void ReportHeadlessFrameRate(bool isFinal);
+	void LogSimulationChecksum();
 	int windowWidth;
 	int windowHeight;
 	int refreshRate = 60;
@@ -0,0 +1,51 @@
+#include <utility>
+#include "SimulationThread.h"
+#include "../Profiler/Profiler.h"
+
+SimulationThread::SimulationThread(std::function<void()> simulateFrame) : simulateFrame(std::move(simulateFrame)) {
+	thread = std::thread(&SimulationThread::Run, this);
+}
+
+SimulationThread::~SimulationThread() {
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void SimulationThread::Kick() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isFramePending = true;
+	}
+	wake.notify_one();
+}
+
+void SimulationThread::Wait() {
+	PROFILE_SCOPE("SimulationThread::Wait");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return !isFramePending; });
+}
+
+void SimulationThread::Run() {
+	Profiler::SetThreadName("Simulation");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this]() { return isFramePending || isStopping; });
+		if (isStopping) {
+			return;
+		}
+
+		lock.unlock();
+		simulateFrame();
+		lock.lock();
+
+		isFramePending = false;
+		done.notify_one();
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Runs the simulation of a frame on its own thread while the main thread draws the previous one.
+// The main thread Kicks a frame and Waits for it before it uses its results, one frame at a time.
+// Everything between Wait and the next Kick is the main thread's alone, that's where it reads the registry.
+class SimulationThread {
+private:
+	std::function<void()> simulateFrame;
+	std::thread thread;
+
+	// Everything below is guarded by mutex
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool isFramePending = false;
+	bool isStopping = false;
+
+	void Run();
+public:
+	explicit SimulationThread(std::function<void()> simulateFrame);
+	// Finishes the frame in flight, then stops the thread
+	~SimulationThread();
+	SimulationThread(const SimulationThread&) = delete;
+	SimulationThread& operator =(const SimulationThread&) = delete;
+
+	// Starts simulating a frame, the previous one has to be waited for first
+	void Kick();
+	// Blocks until the kicked frame is done, returns straight away when none is in flight
+	void Wait();
+};
+
+#endif
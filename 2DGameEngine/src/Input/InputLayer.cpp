@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include "InputLayer.h"
+#include "../Logger/Logger.h"
+
+constexpr char InputLayer::MAGIC[8];
+
+InputLayer::~InputLayer() {
+	Stop();
+}
+
+bool InputLayer::StartRecording(const std::string& path) {
+	Stop();
+
+	recordFile.open(path, std::ios::binary | std::ios::trunc);
+	if (!recordFile) {
+		LOG_ERR(LogCategory::Input, "Could not create input recording {}", path);
+		return false;
+	}
+
+	Header header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	recordFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	mode = Mode::Record;
+	LOG_INFO(LogCategory::Input, "Recording input to {}", path);
+	return true;
+}
+
+bool InputLayer::StartReplay(const std::string& path) {
+	Stop();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		LOG_ERR(LogCategory::Input, "Could not open input recording {}", path);
+		return false;
+	}
+
+	// Recordings are a few bytes per frame, reading the whole file keeps the frames free of file IO
+	replayData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	Header header;
+	if (replayData.size() < sizeof(header)) {
+		LOG_ERR(LogCategory::Input, "{} is not an input recording", path);
+		return false;
+	}
+	std::memcpy(&header, replayData.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+		LOG_ERR(LogCategory::Input, "{} is not an input recording", path);
+		return false;
+	}
+
+	replayOffset = sizeof(header);
+	replayFrame = 0;
+	numReplayEvents = 0;
+	isReplayFinished = replayOffset >= replayData.size();
+	mode = Mode::Replay;
+	LOG_INFO(LogCategory::Input, "Replaying input from {}", path);
+	return true;
+}
+
+void InputLayer::Stop() {
+	if (recordFile.is_open()) {
+		recordFile.close();
+	}
+
+	replayData.clear();
+	frameEvents.clear();
+	mode = Mode::Live;
+}
+
+// Only what the game reacts to is recorded, window and driver events are not part of the simulation
+bool InputLayer::IsRecordable(const SDL_Event& event) {
+	switch (event.type) {
+	case SDL_QUIT:
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEWHEEL:
+		return true;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		return !IsDebugKey(event);
+	default:
+		return false;
+	}
+}
+
+bool InputLayer::IsDebugKey(const SDL_Event& event) {
+	return (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) &&
+		event.key.keysym.sym >= SDLK_F1 && event.key.keysym.sym <= SDLK_F12;
+}
+
+void InputLayer::BeginFrame() {
+	if (mode != Mode::Replay || isReplayFinished) {
+		return;
+	}
+
+	uint16_t numEvents = 0;
+	if (!Read(&frameDeltaTime, sizeof(frameDeltaTime)) || !Read(&numEvents, sizeof(numEvents))) {
+		LOG_ERR(LogCategory::Input, "Input recording is cut off in frame {}", replayFrame);
+		isReplayFinished = true;
+		numReplayEvents = 0;
+		return;
+	}
+	numReplayEvents = numEvents;
+}
+
+bool InputLayer::PollEvent(SDL_Event& event) {
+	if (mode != Mode::Replay) {
+		while (SDL_PollEvent(&event)) {
+			if (mode == Mode::Record && IsRecordable(event)) {
+				frameEvents.push_back(event);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// Keep the window responsive and the debug tools usable, everything else comes from the recording
+	SDL_Event liveEvent;
+	while (SDL_PollEvent(&liveEvent)) {
+		if (liveEvent.type == SDL_QUIT || IsDebugKey(liveEvent)) {
+			event = liveEvent;
+			return true;
+		}
+	}
+
+	if (numReplayEvents == 0) {
+		return false;
+	}
+
+	numReplayEvents--;
+	if (!ReadEvent(event)) {
+		LOG_ERR(LogCategory::Input, "Input recording is corrupt in frame {}", replayFrame);
+		isReplayFinished = true;
+		numReplayEvents = 0;
+		return false;
+	}
+	return true;
+}
+
+double InputLayer::GetDeltaTime(double measuredDeltaTime) {
+	if (mode == Mode::Replay && !isReplayFinished) {
+		return frameDeltaTime;
+	}
+
+	frameDeltaTime = measuredDeltaTime;
+	return measuredDeltaTime;
+}
+
+void InputLayer::EndFrame() {
+	if (mode == Mode::Record) {
+		const uint16_t numEvents = static_cast<uint16_t>(std::min<size_t>(frameEvents.size(), UINT16_MAX));
+		recordFile.write(reinterpret_cast<const char*>(&frameDeltaTime), sizeof(frameDeltaTime));
+		recordFile.write(reinterpret_cast<const char*>(&numEvents), sizeof(numEvents));
+		for (int i = 0; i < numEvents; i++) {
+			WriteEvent(frameEvents[i]);
+		}
+		frameEvents.clear();
+		return;
+	}
+
+	if (mode == Mode::Replay && !isReplayFinished) {
+		// Events the game didn't poll still belong to this frame
+		SDL_Event unused;
+		while (numReplayEvents > 0 && !isReplayFinished) {
+			numReplayEvents--;
+			if (!ReadEvent(unused)) {
+				isReplayFinished = true;
+			}
+		}
+
+		replayFrame++;
+		if (replayOffset >= replayData.size()) {
+			isReplayFinished = true;
+		}
+	}
+}
+
+void InputLayer::WriteEvent(const SDL_Event& event) {
+	auto write = [this](const auto& value) {
+		recordFile.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	};
+
+	switch (event.type) {
+	case SDL_QUIT:
+		write(static_cast<uint8_t>(EVENT_QUIT));
+		break;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		write(static_cast<uint8_t>(event.type == SDL_KEYDOWN ? EVENT_KEY_DOWN : EVENT_KEY_UP));
+		write(static_cast<int32_t>(event.key.keysym.sym));
+		write(static_cast<int32_t>(event.key.keysym.scancode));
+		write(static_cast<uint16_t>(event.key.keysym.mod));
+		write(static_cast<uint8_t>(event.key.repeat));
+		break;
+	case SDL_MOUSEMOTION:
+		write(static_cast<uint8_t>(EVENT_MOUSE_MOTION));
+		write(static_cast<int32_t>(event.motion.x));
+		write(static_cast<int32_t>(event.motion.y));
+		write(static_cast<int32_t>(event.motion.xrel));
+		write(static_cast<int32_t>(event.motion.yrel));
+		write(static_cast<uint32_t>(event.motion.state));
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		write(static_cast<uint8_t>(event.type == SDL_MOUSEBUTTONDOWN ? EVENT_MOUSE_BUTTON_DOWN : EVENT_MOUSE_BUTTON_UP));
+		write(static_cast<uint8_t>(event.button.button));
+		write(static_cast<uint8_t>(event.button.clicks));
+		write(static_cast<int32_t>(event.button.x));
+		write(static_cast<int32_t>(event.button.y));
+		break;
+	case SDL_MOUSEWHEEL:
+		write(static_cast<uint8_t>(EVENT_MOUSE_WHEEL));
+		write(static_cast<int32_t>(event.wheel.x));
+		write(static_cast<int32_t>(event.wheel.y));
+		break;
+	}
+}
+
+bool InputLayer::Read(void* value, size_t size) {
+	if (replayOffset + size > replayData.size()) {
+		return false;
+	}
+	std::memcpy(value, replayData.data() + replayOffset, size);
+	replayOffset += size;
+	return true;
+}
+
+bool InputLayer::ReadEvent(SDL_Event& event) {
+	std::memset(&event, 0, sizeof(event));
+
+	uint8_t type;
+	if (!Read(&type, sizeof(type))) {
+		return false;
+	}
+
+	switch (type) {
+	case EVENT_QUIT:
+		event.type = SDL_QUIT;
+		return true;
+	case EVENT_KEY_DOWN:
+	case EVENT_KEY_UP: {
+		int32_t sym;
+		int32_t scancode;
+		uint16_t mod;
+		uint8_t repeat;
+		if (!Read(&sym, sizeof(sym)) || !Read(&scancode, sizeof(scancode)) || !Read(&mod, sizeof(mod)) || !Read(&repeat, sizeof(repeat))) {
+			return false;
+		}
+		event.type = type == EVENT_KEY_DOWN ? SDL_KEYDOWN : SDL_KEYUP;
+		event.key.state = type == EVENT_KEY_DOWN ? 1 : 0;
+		event.key.keysym.sym = static_cast<SDL_Keycode>(sym);
+		event.key.keysym.scancode = static_cast<decltype(event.key.keysym.scancode)>(scancode);
+		event.key.keysym.mod = mod;
+		event.key.repeat = repeat;
+		return true;
+	}
+	case EVENT_MOUSE_MOTION: {
+		int32_t values[4];
+		uint32_t state;
+		if (!Read(values, sizeof(values)) || !Read(&state, sizeof(state))) {
+			return false;
+		}
+		event.type = SDL_MOUSEMOTION;
+		event.motion.x = values[0];
+		event.motion.y = values[1];
+		event.motion.xrel = values[2];
+		event.motion.yrel = values[3];
+		event.motion.state = state;
+		return true;
+	}
+	case EVENT_MOUSE_BUTTON_DOWN:
+	case EVENT_MOUSE_BUTTON_UP: {
+		uint8_t button;
+		uint8_t clicks;
+		int32_t position[2];
+		if (!Read(&button, sizeof(button)) || !Read(&clicks, sizeof(clicks)) || !Read(position, sizeof(position))) {
+			return false;
+		}
+		event.type = type == EVENT_MOUSE_BUTTON_DOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+		event.button.button = button;
+		event.button.state = type == EVENT_MOUSE_BUTTON_DOWN ? 1 : 0;
+		event.button.clicks = clicks;
+		event.button.x = position[0];
+		event.button.y = position[1];
+		return true;
+	}
+	case EVENT_MOUSE_WHEEL: {
+		int32_t amount[2];
+		if (!Read(amount, sizeof(amount))) {
+			return false;
+		}
+		event.type = SDL_MOUSEWHEEL;
+		event.wheel.x = amount[0];
+		event.wheel.y = amount[1];
+		return true;
+	}
+	default:
+		return false;
+	}
+}
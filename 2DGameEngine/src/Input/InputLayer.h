@@ -0,0 +1,94 @@
+#ifndef INPUTLAYER_H
+#define INPUTLAYER_H
+
+#include <SDL.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+// Where the game gets its input from each frame.
+// Live: straight from SDL_PollEvent.
+// Record: from SDL, and every frame's events plus its dt are written to a file.
+// Replay: the events and dt of a recording are fed back frame by frame, so the simulation does exactly what it did
+// when it was recorded. Live input is ignored during a replay except for SDL_QUIT and the function keys,
+// which drive the debug tools (overlay, profiler) and are never recorded.
+//
+// File layout: Header, then one frame after the other:
+//   double deltaTime, uint16_t numEvents, numEvents times (uint8_t EventType, the fields of that type)
+class InputLayer {
+public:
+	static constexpr char MAGIC[8] = { '2', 'D', 'G', 'E', 'I', 'N', 'P', '\0' };
+	static constexpr uint32_t VERSION = 1;
+
+	enum class Mode {
+		Live,
+		Record,
+		Replay
+	};
+
+	enum EventType : uint8_t {
+		EVENT_QUIT = 1,
+		EVENT_KEY_DOWN = 2,
+		EVENT_KEY_UP = 3,
+		EVENT_MOUSE_MOTION = 4,
+		EVENT_MOUSE_BUTTON_DOWN = 5,
+		EVENT_MOUSE_BUTTON_UP = 6,
+		EVENT_MOUSE_WHEEL = 7
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+	};
+
+private:
+	Mode mode = Mode::Live;
+	std::ofstream recordFile;
+
+	// Record: the events of the current frame, written out in EndFrame
+	std::vector<SDL_Event> frameEvents;
+	double frameDeltaTime = 0.0;
+
+	// Replay: the whole recording, replayOffset is where the next frame starts
+	std::vector<char> replayData;
+	size_t replayOffset = 0;
+	int numReplayEvents = 0;
+	int replayFrame = 0;
+	bool isReplayFinished = false;
+
+	static bool IsRecordable(const SDL_Event& event);
+	static bool IsDebugKey(const SDL_Event& event);
+	void WriteEvent(const SDL_Event& event);
+	bool ReadEvent(SDL_Event& event);
+	bool Read(void* value, size_t size);
+public:
+	InputLayer() = default;
+	~InputLayer();
+	InputLayer(const InputLayer&) = delete;
+	InputLayer& operator =(const InputLayer&) = delete;
+
+	// Both return false (and stay live) if the file can't be opened or isn't a recording
+	bool StartRecording(const std::string& path);
+	bool StartReplay(const std::string& path);
+	// Ends a recording or replay, input goes back to live
+	void Stop();
+
+	Mode GetMode() const { return mode; }
+	// True once a replay has fed its last frame
+	bool IsReplayFinished() const { return isReplayFinished; }
+	int GetReplayFrame() const { return replayFrame; }
+
+	// Call once per frame before polling
+	void BeginFrame();
+	// Next event of this frame, false when there are none left
+	bool PollEvent(SDL_Event& event);
+	// The dt the simulation steps with this frame: measuredDeltaTime, or the recorded one during a replay
+	double GetDeltaTime(double measuredDeltaTime);
+	// Call once per frame after the simulation has stepped
+	void EndFrame();
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include <string>
+#include "JobSystem.h"
+#include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
+
+// The job system and worker index of the calling thread
+static thread_local const JobSystem* threadJobSystem = nullptr;
+static thread_local int threadWorkerIndex = -1;
+
+// Failed attempts to find a job before a worker goes to sleep
+static constexpr int IDLE_SPINS = 64;
+
+bool WorkStealingDeque::Push(Job* job) {
+	const int64_t b = bottom.load(std::memory_order_relaxed);
+	const int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= CAPACITY) {
+		return false;
+	}
+
+	slots[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+Job* WorkStealingDeque::Pop() {
+	// Claim the bottom slot first, then look whether a thief got to it as well
+	const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_seq_cst);
+
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (t == b) {
+		// Last job: whoever moves top first gets it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingDeque::Steal() {
+	int64_t t = top.load(std::memory_order_seq_cst);
+	const int64_t b = bottom.load(std::memory_order_seq_cst);
+	if (t >= b) {
+		return nullptr;
+	}
+
+	Job* job = slots[t & (CAPACITY - 1)].load(std::memory_order_acquire);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		// Lost to the owner or another thief
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem::JobSystem(int numWorkers) {
+	numWorkers = std::max(numWorkers, 0);
+	for (int i = 0; i < numWorkers; i++) {
+		deques.push_back(std::make_unique<WorkStealingDeque>());
+	}
+
+	// Only start the threads once every deque exists, they steal from all of them
+	for (int i = 0; i < numWorkers; i++) {
+		workers.emplace_back([this, i]() {
+			WorkerLoop(i);
+		});
+	}
+
+	LOG_INFO(LogCategory::General, "Job system started with {} worker threads", numWorkers);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		isStopping.store(true, std::memory_order_relaxed);
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+int JobSystem::GetWorkerIndex() const {
+	return threadJobSystem == this ? threadWorkerIndex : -1;
+}
+
+void JobSystem::Run(Job* jobs, int numJobs, JobCounter& counter) {
+	if (numJobs <= 0) {
+		return;
+	}
+
+	counter.value.fetch_add(numJobs, std::memory_order_relaxed);
+
+	// Nobody to hand the work to
+	if (workers.empty()) {
+		for (int i = 0; i < numJobs; i++) {
+			jobs[i].counter = &counter;
+			Execute(&jobs[i]);
+		}
+		return;
+	}
+
+	const int workerIndex = GetWorkerIndex();
+	if (workerIndex < 0) {
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		for (int i = 0; i < numJobs; i++) {
+			jobs[i].counter = &counter;
+			sharedQueue.push_back(&jobs[i]);
+		}
+		sharedQueueSize.fetch_add(numJobs, std::memory_order_relaxed);
+		numQueued.fetch_add(numJobs, std::memory_order_seq_cst);
+	} else {
+		for (int i = 0; i < numJobs; i++) {
+			jobs[i].counter = &counter;
+			Submit(&jobs[i]);
+		}
+	}
+
+	WakeWorkers(numJobs);
+}
+
+// Calling worker's own deque
+void JobSystem::Submit(Job* job) {
+	if (!deques[GetWorkerIndex()]->Push(job)) {
+		// Full: the worker has more queued than anyone can steal anyway, run it right here
+		Execute(job);
+		return;
+	}
+	numQueued.fetch_add(1, std::memory_order_seq_cst);
+}
+
+void JobSystem::WakeWorkers(int numJobs) {
+	if (numSleeping.load(std::memory_order_seq_cst) == 0) {
+		return;
+	}
+
+	// Taking the lock orders this with a worker that is about to sleep, so it can't miss the jobs
+	std::lock_guard<std::mutex> lock(sleepMutex);
+	if (numJobs == 1) {
+		wake.notify_one();
+	} else {
+		wake.notify_all();
+	}
+}
+
+Job* JobSystem::FindJob() {
+	const int workerIndex = GetWorkerIndex();
+	if (workerIndex >= 0) {
+		if (Job* job = deques[workerIndex]->Pop()) {
+			numQueued.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	if (sharedQueueSize.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		if (!sharedQueue.empty()) {
+			Job* job = sharedQueue.front();
+			sharedQueue.pop_front();
+			sharedQueueSize.fetch_sub(1, std::memory_order_relaxed);
+			numQueued.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	// Start at the next worker so the thieves spread out instead of all hitting worker 0
+	const int numDeques = static_cast<int>(deques.size());
+	for (int i = 1; i <= numDeques; i++) {
+		const int victim = (workerIndex + i + numDeques) % numDeques;
+		if (victim == workerIndex) {
+			continue;
+		}
+
+		if (Job* job = deques[victim]->Steal()) {
+			numQueued.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobSystem::Execute(Job* job) {
+	JobCounter* counter = job->counter;
+	job->function(job->data, job->first, job->last);
+	// The job may be gone once the counter drops, it belongs to whoever waits on it
+	counter->value.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	PROFILE_SCOPE("JobSystem::Wait");
+
+	while (!counter.IsDone()) {
+		if (Job* job = FindJob()) {
+			Execute(job);
+		} else {
+			// The last jobs are running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(int workerIndex) {
+	threadJobSystem = this;
+	threadWorkerIndex = workerIndex;
+	Profiler::SetThreadName("Job worker " + std::to_string(workerIndex + 1));
+
+	int idleSpins = 0;
+	while (!isStopping.load(std::memory_order_relaxed)) {
+		if (Job* job = FindJob()) {
+			Execute(job);
+			idleSpins = 0;
+			continue;
+		}
+
+		// Frame work comes in bursts, spin a little before paying for a sleep and a wake up
+		if (++idleSpins < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+		idleSpins = 0;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		numSleeping.fetch_add(1, std::memory_order_seq_cst);
+		wake.wait(lock, [this]() {
+			return isStopping.load(std::memory_order_relaxed) || numQueued.load(std::memory_order_seq_cst) > 0;
+		});
+		numSleeping.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,157 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+class JobCounter;
+
+// One unit of work: function(data, first, last). Plain data, the submitter owns it and has to keep it
+// alive until its counter reaches zero (Wait does that)
+struct Job {
+	void (*function)(void* data, int first, int last);
+	void* data;
+	int first;
+	int last;
+	JobCounter* counter;
+};
+
+// Number of submitted jobs that haven't finished yet. Waiting for it to reach zero is the fence
+// between a batch of jobs and whatever depends on them
+class JobCounter {
+private:
+	std::atomic<int> value{ 0 };
+
+	friend class JobSystem;
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator =(const JobCounter&) = delete;
+
+	bool IsDone() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+// Chase-Lev work stealing deque of a fixed capacity.
+// The owning worker pushes and pops at the bottom (newest first, still warm in its cache),
+// other threads steal from the top (oldest first, usually the biggest pieces of work left)
+class WorkStealingDeque {
+public:
+	static constexpr int64_t CAPACITY = 4096;
+
+private:
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	std::unique_ptr<std::atomic<Job*>[]> slots;
+public:
+	WorkStealingDeque() : slots(new std::atomic<Job*>[CAPACITY]) {}
+
+	// Owner only, false when the deque is full
+	bool Push(Job* job);
+	// Owner only
+	Job* Pop();
+	// Any thread
+	Job* Steal();
+	bool IsEmpty() const { return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed); }
+};
+
+// Work stealing job system, the one pool of worker threads the engine runs parallel work on.
+// Every worker has its own deque: jobs a worker submits go to its own deque, jobs from other threads
+// (main, simulation, loaders) go to a shared queue. Idle workers steal from each other.
+// Threads waiting on a counter run jobs instead of blocking, so waiting from inside a job is fine.
+//
+//	jobSystem.ParallelFor(numEntities, 256, [&](int first, int last) { ... });
+class JobSystem {
+public:
+	// Ranges ParallelFor keeps on the stack before it allocates
+	static constexpr int INLINE_JOBS = 64;
+
+private:
+	std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+	std::vector<std::thread> workers;
+
+	// Jobs submitted by threads that aren't workers
+	std::mutex sharedMutex;
+	std::deque<Job*> sharedQueue;
+	std::atomic<int> sharedQueueSize{ 0 };
+
+	// Jobs queued and not picked up yet, what sleeping workers wait for
+	std::atomic<int> numQueued{ 0 };
+	std::atomic<int> numSleeping{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<bool> isStopping{ false };
+
+	void WorkerLoop(int workerIndex);
+	// Pops, takes from the shared queue or steals one job, nullptr when there is nothing to do
+	Job* FindJob();
+	void Execute(Job* job);
+	void Submit(Job* job);
+	void WakeWorkers(int numJobs);
+
+	template <typename TFunc>
+	static void RunRange(void* data, int first, int last) {
+		(*static_cast<TFunc*>(data))(first, last);
+	}
+public:
+	// numWorkers extra threads are started, threads that Wait work as well
+	explicit JobSystem(int numWorkers = static_cast<int>(std::thread::hardware_concurrency()) - 1);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator =(const JobSystem&) = delete;
+
+	// Queues numJobs jobs and adds them to counter. jobs must stay alive until counter is done
+	void Run(Job* jobs, int numJobs, JobCounter& counter);
+	// Runs jobs until counter reaches zero
+	void Wait(JobCounter& counter);
+
+	// Calls func(first, last) for ranges of at most grainSize items covering [0, count) and waits for all of them
+	template <typename TFunc>
+	void ParallelFor(int count, int grainSize, TFunc&& func);
+
+	int GetNumWorkers() const { return static_cast<int>(workers.size()); }
+	// Worker index of the calling thread, -1 for threads that aren't workers of this job system
+	int GetWorkerIndex() const;
+};
+
+template <typename TFunc>
+void JobSystem::ParallelFor(int count, int grainSize, TFunc&& func) {
+	if (count <= 0) {
+		return;
+	}
+
+	grainSize = std::max(grainSize, 1);
+	if (count <= grainSize || workers.empty()) {
+		func(0, count);
+		return;
+	}
+
+	using Func = std::remove_reference_t<TFunc>;
+	const int numJobs = (count + grainSize - 1) / grainSize;
+
+	Job inlineJobs[INLINE_JOBS];
+	std::vector<Job> heapJobs;
+	Job* jobs = inlineJobs;
+	if (numJobs > INLINE_JOBS) {
+		heapJobs.resize(numJobs);
+		jobs = heapJobs.data();
+	}
+
+	JobCounter counter;
+	for (int i = 0; i < numJobs; i++) {
+		const int first = i * grainSize;
+		jobs[i] = { &RunRange<Func>, const_cast<void*>(static_cast<const void*>(&func)), first, std::min(first + grainSize, count), nullptr };
+	}
+
+	Run(jobs, numJobs, counter);
+	Wait(counter);
+}
+
+#endif
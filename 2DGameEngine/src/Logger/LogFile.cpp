@@ -0,0 +1,287 @@
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include "LogFile.h"
+#include "../Memory/MemoryTracker.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+constexpr char LogFile::MAGIC[8];
+
+LogFile::~LogFile() {
+	Close();
+}
+
+bool LogFile::Open(const std::string& path, size_t fileCapacity) {
+	Close();
+
+	if (fileCapacity < sizeof(Header)) {
+		return false;
+	}
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	const uint64_t capacity64 = fileCapacity;
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(capacity64 >> 32), static_cast<DWORD>(capacity64), nullptr);
+	if (!mapping) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* mappedView = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, fileCapacity);
+	if (!mappedView) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+#else
+	const int descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (descriptor < 0) {
+		return false;
+	}
+
+	if (ftruncate(descriptor, static_cast<off_t>(fileCapacity)) != 0) {
+		close(descriptor);
+		return false;
+	}
+
+	void* mappedView = mmap(nullptr, fileCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	if (mappedView == MAP_FAILED) {
+		close(descriptor);
+		return false;
+	}
+
+	fileDescriptor = descriptor;
+#endif
+
+	view = static_cast<char*>(mappedView);
+	capacity = fileCapacity;
+	MemoryTracker::Allocate(MemoryTag::LogFile, capacity);
+	size = sizeof(Header);
+	formatIds.clear();
+
+	Header header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.capacity = capacity;
+	header.size = size;
+	header.clockNumerator = std::chrono::system_clock::period::num;
+	header.clockDenominator = std::chrono::system_clock::period::den;
+	std::memcpy(view, &header, sizeof(header));
+
+	return true;
+}
+
+void LogFile::Close() {
+	if (!view) {
+		return;
+	}
+
+	Commit();
+
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+	CloseHandle(static_cast<HANDLE>(mappingHandle));
+
+	LARGE_INTEGER end;
+	end.QuadPart = static_cast<LONGLONG>(size);
+	SetFilePointerEx(static_cast<HANDLE>(fileHandle), end, nullptr, FILE_BEGIN);
+	SetEndOfFile(static_cast<HANDLE>(fileHandle));
+	CloseHandle(static_cast<HANDLE>(fileHandle));
+
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	munmap(view, capacity);
+	if (ftruncate(fileDescriptor, static_cast<off_t>(size)) != 0) {
+		// The file keeps its preallocated tail, Decode stops at header.size anyway
+	}
+	close(fileDescriptor);
+
+	fileDescriptor = -1;
+#endif
+
+	MemoryTracker::Free(MemoryTag::LogFile, capacity);
+	view = nullptr;
+	capacity = 0;
+	size = 0;
+}
+
+bool LogFile::Reserve(size_t entrySize) {
+	if (size + entrySize <= capacity) {
+		return true;
+	}
+
+	GetHeader()->flags |= FLAG_FULL;
+	return false;
+}
+
+void LogFile::Append(const void* data, size_t dataSize) {
+	std::memcpy(view + size, data, dataSize);
+	size += dataSize;
+}
+
+bool LogFile::Write(const LogRecord& record) {
+	if (!view) {
+		return true;
+	}
+
+	// The format pointer only means something inside this process, the file gets the string once and an id after that
+	auto format = formatIds.find(record.format);
+	if (format == formatIds.end()) {
+		const size_t length = std::strlen(record.format);
+		const uint16_t storedLength = static_cast<uint16_t>(std::min<size_t>(length, UINT16_MAX));
+		if (!Reserve(1 + sizeof(uint32_t) + sizeof(uint16_t) + storedLength)) {
+			return false;
+		}
+
+		const uint32_t id = static_cast<uint32_t>(formatIds.size());
+		const uint8_t type = ENTRY_FORMAT;
+		Append(&type, sizeof(type));
+		Append(&id, sizeof(id));
+		Append(&storedLength, sizeof(storedLength));
+		Append(record.format, storedLength);
+
+		format = formatIds.emplace(record.format, id).first;
+	}
+
+	const size_t recordSize = 1 + sizeof(uint32_t) + sizeof(int64_t) + 4 + sizeof(uint16_t) + record.payloadSize;
+	if (!Reserve(recordSize)) {
+		return false;
+	}
+
+	const uint8_t type = ENTRY_RECORD;
+	const uint8_t level = static_cast<uint8_t>(record.level);
+	const uint8_t category = static_cast<uint8_t>(record.category);
+	Append(&type, sizeof(type));
+	Append(&format->second, sizeof(uint32_t));
+	Append(&record.timestamp, sizeof(record.timestamp));
+	Append(&level, sizeof(level));
+	Append(&category, sizeof(category));
+	Append(&record.numArguments, sizeof(record.numArguments));
+	Append(&record.isTruncated, sizeof(record.isTruncated));
+	Append(&record.payloadSize, sizeof(record.payloadSize));
+	Append(record.payload, record.payloadSize);
+	return true;
+}
+
+void LogFile::Commit() {
+	if (view) {
+		GetHeader()->size = size;
+	}
+}
+
+bool LogFile::Decode(const std::string& path, std::string& output) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (data.size() < sizeof(Header)) {
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+		return false;
+	}
+
+	const size_t end = static_cast<size_t>(std::min<uint64_t>(header.size, data.size()));
+	size_t offset = sizeof(Header);
+	std::vector<std::string> formats;
+	std::string entry;
+
+	auto read = [&data, &offset, end](void* value, size_t valueSize) {
+		if (offset + valueSize > end) {
+			return false;
+		}
+		std::memcpy(value, data.data() + offset, valueSize);
+		offset += valueSize;
+		return true;
+	};
+
+	while (offset < end) {
+		uint8_t type;
+		if (!read(&type, sizeof(type))) {
+			break;
+		}
+
+		if (type == ENTRY_FORMAT) {
+			uint32_t id;
+			uint16_t length;
+			if (!read(&id, sizeof(id)) || !read(&length, sizeof(length)) || offset + length > end) {
+				break;
+			}
+			if (id >= formats.size()) {
+				formats.resize(id + 1);
+			}
+			formats[id].assign(data.data() + offset, length);
+			offset += length;
+		} else if (type == ENTRY_RECORD) {
+			const size_t recordOffset = offset - sizeof(type);
+			uint32_t formatId;
+			uint8_t level;
+			uint8_t category;
+			LogRecord record;
+			if (!read(&formatId, sizeof(formatId)) ||
+				!read(&record.timestamp, sizeof(record.timestamp)) ||
+				!read(&level, sizeof(level)) ||
+				!read(&category, sizeof(category)) ||
+				!read(&record.numArguments, sizeof(record.numArguments)) ||
+				!read(&record.isTruncated, sizeof(record.isTruncated)) ||
+				!read(&record.payloadSize, sizeof(record.payloadSize)) ||
+				record.payloadSize > LogRecord::PAYLOAD_SIZE ||
+				!read(record.payload, record.payloadSize) ||
+				formatId >= formats.size()) {
+				break;
+			}
+
+			// Convert the writer's clock ticks to ours
+			if (header.clockNumerator != std::chrono::system_clock::period::num || header.clockDenominator != std::chrono::system_clock::period::den) {
+				const double seconds = static_cast<double>(record.timestamp) * header.clockNumerator / header.clockDenominator;
+				record.timestamp = std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double>(seconds)).count();
+			}
+			record.format = formats[formatId].c_str();
+			record.level = static_cast<LogLevel>(level);
+			record.category = static_cast<LogCategory>(category);
+
+			// Formatted on the side so a corrupt record leaves nothing half written behind
+			entry.clear();
+			if (!Logger::FormatEntry(record, entry)) {
+				offset = recordOffset;
+				break;
+			}
+			output += entry;
+			output += '\n';
+		} else {
+			break;
+		}
+	}
+
+	if (offset < end) {
+		output += "Log file is corrupt after byte " + std::to_string(offset) + "\n";
+	}
+	if (header.flags & FLAG_FULL) {
+		output += "Log file ran out of space, later records were dropped\n";
+	}
+
+	return true;
+}
@@ -0,0 +1,84 @@
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "Logger.h"
+
+// Binary log written through a memory mapped file that is preallocated when it is opened.
+// Writing a record is a memcpy into the mapping, the OS writes the pages back in the background.
+//
+// Layout: Header, then entries back to back. An entry is one EntryType byte followed by
+//   ENTRY_FORMAT: uint32_t id, uint16_t length, the format string (written the first time a format is used)
+//   ENTRY_RECORD: uint32_t formatId, int64_t timestamp, uint8_t level, uint8_t category,
+//                 uint8_t numArguments, uint8_t isTruncated, uint16_t payloadSize, payload
+// Decode turns a file back into the same text the console shows.
+class LogFile {
+public:
+	static constexpr char MAGIC[8] = { '2', 'D', 'G', 'E', 'L', 'O', 'G', '\0' };
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+	enum EntryType : uint8_t {
+		ENTRY_FORMAT = 1,
+		ENTRY_RECORD = 2
+	};
+
+	enum HeaderFlags : uint32_t {
+		// Records were dropped because the file ran out of space
+		FLAG_FULL = 1
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t flags;
+		uint64_t capacity;
+		// Bytes in use, header included
+		uint64_t size;
+		// Timestamps are system_clock ticks of the machine that wrote the file, this is their period
+		int64_t clockNumerator;
+		int64_t clockDenominator;
+	};
+
+private:
+	char* view = nullptr;
+	size_t capacity = 0;
+	size_t size = 0;
+	std::unordered_map<const char*, uint32_t> formatIds;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+
+	bool Reserve(size_t entrySize);
+	void Append(const void* data, size_t dataSize);
+	Header* GetHeader() const { return reinterpret_cast<Header*>(view); }
+
+public:
+	LogFile() = default;
+	~LogFile();
+	LogFile(const LogFile&) = delete;
+	LogFile& operator =(const LogFile&) = delete;
+
+	// Creates (or overwrites) path with room for capacity bytes and maps it
+	bool Open(const std::string& path, size_t capacity = DEFAULT_CAPACITY);
+	// Trims the file to the bytes actually used
+	void Close();
+	bool IsOpen() const { return view != nullptr; }
+
+	// False when the record didn't fit and was dropped
+	bool Write(const LogRecord& record);
+	// Publishes the size in the header so a crash leaves a readable file
+	void Commit();
+
+	// Writes the text of every record in the file at path to output, false if it isn't a log file
+	static bool Decode(const std::string& path, std::string& output);
+};
+
+#endif
@@ -1,46 +1,668 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
 #include "Logger.h"
+#include "LogFile.h"
+#include "../Memory/MemoryTracker.h"
 
 // TODO(yudi) : At some point I should make a ansi color format specifier.
 // Terminal color format specifier
 // "\033[{FORMAT_ATTRIBUTE};{FORGROUND_COLOR};{BACKGROUND_COLOR}m{TEXT}\033[{RESET_FORMATE_ATTRIBUTE}m"
 
-std::vector<LogEntry> Logger::messages;
+// Everything that is compiled in is logged until a category is turned down
+std::atomic<uint8_t> Logger::categoryLevels[static_cast<int>(LogCategory::Count)] = {
+	LOG_MIN_LEVEL, LOG_MIN_LEVEL, LOG_MIN_LEVEL, LOG_MIN_LEVEL, LOG_MIN_LEVEL, LOG_MIN_LEVEL
+};
+static_assert(static_cast<int>(LogCategory::Count) == 6, "Add the new category to categoryLevels and GetCategoryName");
 
-void Logger::Log(const std::string& msg) {
-	std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+void LogRecord::AppendRaw(ArgumentType type, const void* value, size_t size) {
+	if (payloadSize + 1 + size > PAYLOAD_SIZE) {
+		isTruncated = true;
+		return;
+	}
+
+	payload[payloadSize] = static_cast<char>(type);
+	std::memcpy(payload + payloadSize + 1, value, size);
+	payloadSize += static_cast<uint16_t>(1 + size);
+	numArguments++;
+}
+
+void LogRecord::AppendString(const char* text, size_t length) {
+	// type + uint16_t length, then the characters that fit
+	const size_t headerSize = 1 + sizeof(uint16_t);
+	if (payloadSize + headerSize > PAYLOAD_SIZE) {
+		isTruncated = true;
+		return;
+	}
+
+	const size_t space = PAYLOAD_SIZE - payloadSize - headerSize;
+	if (length > space) {
+		length = space;
+		isTruncated = true;
+	}
+
+	const uint16_t storedLength = static_cast<uint16_t>(length);
+	payload[payloadSize] = static_cast<char>(ARGUMENT_STRING);
+	std::memcpy(payload + payloadSize + 1, &storedLength, sizeof(storedLength));
+	std::memcpy(payload + payloadSize + headerSize, text, length);
+	payloadSize += static_cast<uint16_t>(headerSize + length);
+	numArguments++;
+}
+
+// Records of one producer thread on their way to the logging thread.
+// Only the owning thread pushes and only the logging thread pops, so two atomics are all the locking needed
+class LogRing {
+public:
+	static constexpr uint32_t CAPACITY = 1024;
+private:
+	std::unique_ptr<LogRecord[]> records;
+	// Written by the logging thread
+	alignas(64) std::atomic<uint32_t> head{ 0 };
+	// Written by the owning thread
+	alignas(64) std::atomic<uint32_t> tail{ 0 };
+	// The owning thread's last look at head, saves touching the logging thread's cache line on every push
+	uint32_t cachedHead = 0;
+public:
+	// Records thrown away because the logging thread stopped while the ring was full
+	std::atomic<uint32_t> numDropped{ 0 };
+	// Cleared when the owning thread exits, another thread can then take the ring over
+	std::atomic<bool> isOwned{ true };
+
+	LogRing() : records(new LogRecord[CAPACITY]) {
+		MemoryTracker::Allocate(MemoryTag::Logger, CAPACITY * sizeof(LogRecord));
+	}
+
+	~LogRing() {
+		MemoryTracker::Free(MemoryTag::Logger, CAPACITY * sizeof(LogRecord));
+	}
+
+	// Owning thread
+	LogRecord* TryAcquire() {
+		const uint32_t position = tail.load(std::memory_order_relaxed);
+		if (position - cachedHead == CAPACITY) {
+			cachedHead = head.load(std::memory_order_acquire);
+			if (position - cachedHead == CAPACITY) {
+				return nullptr;
+			}
+		}
+		return &records[position & (CAPACITY - 1)];
+	}
+
+	void Commit() {
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Logging thread
+	const LogRecord* Front() const {
+		const uint32_t position = head.load(std::memory_order_relaxed);
+		if (position == tail.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &records[position & (CAPACITY - 1)];
+	}
+
+	void Pop() {
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	uint32_t GetSize() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	bool IsEmpty() const {
+		return GetSize() == 0;
+	}
+};
+
+// Owns the rings and the thread that formats and writes the records
+class LogBackend {
+private:
+	std::mutex ringsMutex;
+	std::vector<std::unique_ptr<LogRing>> rings;
+
+	std::thread thread;
+	std::atomic<bool> isRunning{ true };
+
+	// Everything below is guarded by wakeMutex
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	std::condition_variable flushed;
+	uint64_t flushRequested = 0;
+	uint64_t flushCompleted = 0;
+	bool isDrainRequested = false;
+	bool isStopping = false;
+
+	std::atomic<uint64_t> numDropped{ 0 };
+	std::atomic<uint64_t> numStalls{ 0 };
+
+	// Only touched by the logging thread (or under outputMutex once it stopped)
+	std::mutex outputMutex;
+	std::vector<LogRing*> activeRings;
+	std::string message;
+	std::string output;
+	std::string errorOutput;
+	LogFile binaryLog;
+
+	// Ring of the last HISTORY_CAPACITY messages, the strings keep their capacity when a slot is reused
+	std::mutex historyMutex;
+	std::vector<LogEntry> history;
+	int historyNext = 0;
+	int historySize = 0;
+
+	LogBackend() : history(Logger::HISTORY_CAPACITY) {
+		MemoryTracker::Allocate(MemoryTag::Logger, Logger::HISTORY_CAPACITY * sizeof(LogEntry));
+		thread = std::thread(&LogBackend::Run, this);
+	}
+
+	void Run();
+	void Drain();
+	void WriteRecord(const LogRecord& record);
+	void WriteOutput();
+public:
+	// Created on first use and never destroyed, so logging keeps working during static destruction
+	static LogBackend* Get() {
+		static LogBackend* backend = []() {
+			auto* newBackend = new LogBackend();
+			std::atexit([]() { LogBackend::Get()->Stop(); });
+			return newBackend;
+		}();
+		return backend;
+	}
+
+	bool IsRunning() const { return isRunning.load(std::memory_order_acquire); }
+	// Records lost for good: pushed after the logging thread stopped, or not fitting in the binary log
+	void AddDropped() { numDropped.fetch_add(1, std::memory_order_relaxed); }
+	uint64_t GetNumDropped() const { return numDropped.load(std::memory_order_relaxed); }
+	// Times a thread had to wait for room in its ring
+	void AddStall() { numStalls.fetch_add(1, std::memory_order_relaxed); }
+	uint64_t GetNumStalls() const { return numStalls.load(std::memory_order_relaxed); }
+	LogRing* ClaimRing();
+	// Wakes the logging thread up without waiting for it
+	void RequestDrain();
+	void Flush();
+	void Stop();
+	// Used once the logging thread stopped
+	void WriteNow(const LogRecord& record);
+	void GetHistory(std::vector<LogEntry>& entries);
+	bool OpenBinaryLog(const std::string& path, size_t capacity);
+	void CloseBinaryLog();
+};
+
+// Ring of the calling thread, released for reuse when the thread exits
+struct ThreadLogRing {
+	LogRing* ring = nullptr;
+
+	~ThreadLogRing() {
+		if (ring) {
+			ring->isOwned.store(false, std::memory_order_release);
+		}
+	}
+};
+
+static thread_local ThreadLogRing threadLogRing;
+// Used instead of a ring slot when the logging thread isn't running
+static thread_local LogRecord fallbackRecord;
+
+LogRing* LogBackend::ClaimRing() {
+	std::lock_guard<std::mutex> lock(ringsMutex);
+
+	// Threads come and go (scheduler workers, loaders), reuse the ring of one that is gone
+	for (auto& ring : rings) {
+		if (!ring->isOwned.load(std::memory_order_acquire) && ring->IsEmpty()) {
+			ring->isOwned.store(true, std::memory_order_relaxed);
+			return ring.get();
+		}
+	}
+
+	rings.push_back(std::make_unique<LogRing>());
+	return rings.back().get();
+}
+
+void LogBackend::RequestDrain() {
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		isDrainRequested = true;
+	}
+	wake.notify_one();
+}
+
+void LogBackend::Flush() {
+	std::unique_lock<std::mutex> lock(wakeMutex);
+	if (!IsRunning()) {
+		return;
+	}
+
+	const uint64_t ticket = ++flushRequested;
+	wake.notify_one();
+	flushed.wait(lock, [this, ticket]() { return flushCompleted >= ticket || !IsRunning(); });
+}
+
+void LogBackend::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		if (isStopping) {
+			return;
+		}
+		isStopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+
+	CloseBinaryLog();
+}
+
+void LogBackend::Run() {
+	while (true) {
+		uint64_t requested;
+		bool stopping;
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			requested = flushRequested;
+			stopping = isStopping;
+			isDrainRequested = false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(outputMutex);
+			Drain();
+			WriteOutput();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			flushCompleted = requested;
+			flushed.notify_all();
+
+			if (stopping) {
+				isRunning.store(false, std::memory_order_release);
+				flushed.notify_all();
+				return;
+			}
+
+			// Producers never signal, the logging thread just looks again a little later
+			wake.wait_for(lock, std::chrono::milliseconds(2), [this, requested]() {
+				return isStopping || isDrainRequested || flushRequested != requested;
+			});
+		}
+	}
+}
+
+// Writes out what was in the rings when it was called, oldest record first.
+// Records pushed while it runs wait for the next pass so busy producers can't keep it here forever
+void LogBackend::Drain() {
+	{
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		activeRings.clear();
+		for (auto& ring : rings) {
+			activeRings.push_back(ring.get());
+		}
+	}
+
+	uint32_t budget = 0;
+	for (auto* ring : activeRings) {
+		budget += ring->GetSize();
+
+		const uint32_t numDropped = ring->numDropped.exchange(0, std::memory_order_relaxed);
+		if (numDropped > 0) {
+			LogRecord record;
+			record.timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+			record.format = "Logging thread stopped, {} messages were dropped";
+			record.level = LogLevel::Warning;
+			record.category = LogCategory::General;
+			record.payloadSize = 0;
+			record.numArguments = 0;
+			record.isTruncated = false;
+			record.Append(numDropped);
+			WriteRecord(record);
+		}
+	}
+
+	for (; budget > 0; budget--) {
+		LogRing* oldestRing = nullptr;
+		const LogRecord* oldestRecord = nullptr;
+		for (auto* ring : activeRings) {
+			const LogRecord* record = ring->Front();
+			if (record && (!oldestRecord || record->timestamp < oldestRecord->timestamp)) {
+				oldestRing = ring;
+				oldestRecord = record;
+			}
+		}
+
+		if (!oldestRecord) {
+			return;
+		}
 
-	LogEntry logEntry;
-	logEntry.type = LOG_INFO;
-	logEntry.msg_timestamp_timePoint = now;
-	logEntry.msg = "LOG | " + Logger::GetCurrentTimeStampString(now) + msg;
+		WriteRecord(*oldestRecord);
+		oldestRing->Pop();
+	}
+}
+
+// Substitutes the arguments in the payload for the "{}"s of the format.
+// Every read is checked against payloadSize, records read back from a log file can be corrupt.
+// false if an argument runs past the payload or has an unknown type
+static bool FormatArguments(const LogRecord& record, std::string& text) {
+	const size_t payloadSize = std::min<size_t>(record.payloadSize, LogRecord::PAYLOAD_SIZE);
+	size_t offset = 0;
+	int numArguments = 0;
+	char number[32];
+
+	auto read = [&record, &offset, payloadSize](void* value, size_t valueSize) {
+		if (valueSize > payloadSize - offset) {
+			return false;
+		}
+		std::memcpy(value, record.payload + offset, valueSize);
+		offset += valueSize;
+		return true;
+	};
+
+	for (const char* c = record.format; *c != '\0'; c++) {
+		if (c[0] != '{' || c[1] != '}' || numArguments >= record.numArguments) {
+			text += *c;
+			continue;
+		}
+		c++;
+		numArguments++;
+
+		uint8_t type;
+		if (!read(&type, sizeof(type))) {
+			return false;
+		}
+
+		switch (type) {
+			case LogRecord::ARGUMENT_INT: {
+				int64_t value;
+				if (!read(&value, sizeof(value))) {
+					return false;
+				}
+				std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(value));
+				text += number;
+				break;
+			}
+			case LogRecord::ARGUMENT_UINT: {
+				uint64_t value;
+				if (!read(&value, sizeof(value))) {
+					return false;
+				}
+				std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(value));
+				text += number;
+				break;
+			}
+			case LogRecord::ARGUMENT_DOUBLE: {
+				double value;
+				if (!read(&value, sizeof(value))) {
+					return false;
+				}
+				std::snprintf(number, sizeof(number), "%f", value);
+				text += number;
+				break;
+			}
+			case LogRecord::ARGUMENT_BOOL: {
+				// Read as a byte, a bool holding anything but 0 or 1 is undefined
+				uint8_t value;
+				if (!read(&value, sizeof(value))) {
+					return false;
+				}
+				text += value ? "true" : "false";
+				break;
+			}
+			case LogRecord::ARGUMENT_CHAR: {
+				char value;
+				if (!read(&value, sizeof(value))) {
+					return false;
+				}
+				text += value;
+				break;
+			}
+			case LogRecord::ARGUMENT_STRING: {
+				uint16_t length;
+				if (!read(&length, sizeof(length)) || length > payloadSize - offset) {
+					return false;
+				}
+				text.append(record.payload + offset, length);
+				offset += length;
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+
+	if (record.isTruncated) {
+		text += " [truncated]";
+	}
+	return true;
+}
+
+void LogBackend::WriteRecord(const LogRecord& record) {
+	message.clear();
+	Logger::FormatEntry(record, message);
+
+	switch (record.level) {
+		case LogLevel::Trace: output += "\033[0;90;49m"; break;
+		case LogLevel::Debug: output += "\033[0;36;49m"; break;
+		case LogLevel::Info: output += "\033[0;32;49m"; break;
+		case LogLevel::Warning: output += "\033[0;33;49m"; break;
+		case LogLevel::Error: break;
+	}
+	if (record.level == LogLevel::Error) {
+		errorOutput += "\033[0;31;49m";
+		errorOutput += message;
+		errorOutput += "\033[0m\n";
+	} else {
+		output += message;
+		output += "\033[0m\n";
+	}
+
+	if (!binaryLog.Write(record)) {
+		AddDropped();
+	}
+
+	std::lock_guard<std::mutex> lock(historyMutex);
+	auto& logEntry = history[historyNext];
+	logEntry.type = record.level;
+	logEntry.msg_timestamp_timePoint = std::chrono::system_clock::time_point(std::chrono::system_clock::duration(record.timestamp));
+	const size_t oldCapacity = logEntry.msg.capacity();
+	logEntry.msg.assign(message);
+	if (logEntry.msg.capacity() != oldCapacity) {
+		MemoryTracker::Free(MemoryTag::Logger, oldCapacity);
+		MemoryTracker::Allocate(MemoryTag::Logger, logEntry.msg.capacity());
+	}
+	historyNext = (historyNext + 1) % Logger::HISTORY_CAPACITY;
+	historySize = std::min(historySize + 1, Logger::HISTORY_CAPACITY);
+}
+
+// One write and one flush for everything drained in a pass instead of an std::endl per message
+void LogBackend::WriteOutput() {
+	binaryLog.Commit();
+
+	if (!output.empty()) {
+		std::cout.write(output.data(), output.size());
+		std::cout.flush();
+		output.clear();
+	}
+	if (!errorOutput.empty()) {
+		std::cerr.write(errorOutput.data(), errorOutput.size());
+		std::cerr.flush();
+		errorOutput.clear();
+	}
+}
+
+void LogBackend::WriteNow(const LogRecord& record) {
+	std::lock_guard<std::mutex> lock(outputMutex);
+	WriteRecord(record);
+	WriteOutput();
+}
+
+void LogBackend::GetHistory(std::vector<LogEntry>& entries) {
+	std::lock_guard<std::mutex> lock(historyMutex);
+	entries.clear();
+	entries.reserve(historySize);
+	const int first = (historyNext - historySize + Logger::HISTORY_CAPACITY) % Logger::HISTORY_CAPACITY;
+	for (int i = 0; i < historySize; i++) {
+		entries.push_back(history[(first + i) % Logger::HISTORY_CAPACITY]);
+	}
+}
+
+bool LogBackend::OpenBinaryLog(const std::string& path, size_t capacity) {
+	std::lock_guard<std::mutex> lock(outputMutex);
+	return binaryLog.Open(path, capacity);
+}
+
+void LogBackend::CloseBinaryLog() {
+	std::lock_guard<std::mutex> lock(outputMutex);
+	binaryLog.Close();
+}
+
+LogRecord* Logger::BeginRecord(LogLevel level, LogCategory category, const char* format) {
+	LogBackend* backend = LogBackend::Get();
+
+	LogRecord* record;
+	if (!backend->IsRunning()) {
+		record = &fallbackRecord;
+	} else {
+		if (!threadLogRing.ring) {
+			threadLogRing.ring = backend->ClaimRing();
+		}
 
-	std::cout << "\033[0;32;49m";
-	std::cout << logEntry.msg << std::endl;
-	std::cout << "\033[0m";
+		record = threadLogRing.ring->TryAcquire();
+		if (!record) {
+			// Full: hurry the logging thread along and wait for a slot rather than lose the message
+			backend->AddStall();
+			backend->RequestDrain();
+			while (!(record = threadLogRing.ring->TryAcquire())) {
+				if (!backend->IsRunning()) {
+					threadLogRing.ring->numDropped.fetch_add(1, std::memory_order_relaxed);
+					backend->AddDropped();
+					return nullptr;
+				}
+				std::this_thread::yield();
+			}
+		}
+	}
 
-	messages.push_back(logEntry);
+	record->timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+	record->format = format;
+	record->level = level;
+	record->category = category;
+	record->payloadSize = 0;
+	record->numArguments = 0;
+	record->isTruncated = false;
+	return record;
+}
+
+void Logger::EndRecord(LogRecord* record) {
+	if (record == &fallbackRecord) {
+		LogBackend::Get()->WriteNow(*record);
+		return;
+	}
+
+	const LogLevel level = record->level;
+	threadLogRing.ring->Commit();
+
+	// Errors tend to come right before a crash, make sure they are out
+	if (level == LogLevel::Error) {
+		Flush();
+	}
+}
+
+void Logger::Flush() {
+	LogBackend::Get()->Flush();
+}
+
+void Logger::Log(const std::string& msg) {
+	LOG_INFO(LogCategory::General, "{}", msg);
 }
 
 void Logger::Err(const std::string& msg) {
-	std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+	LOG_ERR(LogCategory::General, "{}", msg);
+}
 
-	LogEntry logEntry;
-	logEntry.type = LOG_ERROR;
-	logEntry.msg_timestamp_timePoint = now;
-	logEntry.msg = "ERR | " + Logger::GetCurrentTimeStampString(now) + msg;
+bool Logger::FormatEntry(const LogRecord& record, std::string& text) {
+	if (record.level > LogLevel::Error || record.category >= LogCategory::Count) {
+		return false;
+	}
 
-	std::cout << "\033[0;31;49m";
-	std::cerr << logEntry.msg << std::endl;
-	std::cout << "\033[0m";
+	// strftime only once per second
+	static thread_local int64_t cachedSecond = -1;
+	static thread_local std::string cachedTimeStamp;
+
+	const std::chrono::system_clock::time_point timePoint{ std::chrono::system_clock::duration(record.timestamp) };
+	const int64_t second = std::chrono::duration_cast<std::chrono::seconds>(timePoint.time_since_epoch()).count();
+	if (second != cachedSecond) {
+		cachedSecond = second;
+		cachedTimeStamp = GetCurrentTimeStampString(timePoint);
+	}
+
+	text += GetLevelName(record.level);
+	text += " | ";
+	text += cachedTimeStamp;
+	if (record.category != LogCategory::General) {
+		text += '[';
+		text += GetCategoryName(record.category);
+		text += "] ";
+	}
+	return FormatArguments(record, text);
+}
+
+void Logger::GetHistory(std::vector<LogEntry>& entries) {
+	LogBackend::Get()->GetHistory(entries);
+}
+
+uint64_t Logger::GetNumDropped() {
+	return LogBackend::Get()->GetNumDropped();
+}
+
+uint64_t Logger::GetNumStalls() {
+	return LogBackend::Get()->GetNumStalls();
+}
+
+bool Logger::OpenBinaryLog(const std::string& path, size_t capacity) {
+	if (!LogBackend::Get()->OpenBinaryLog(path, capacity)) {
+		LOG_ERR(LogCategory::General, "Could not open binary log {}", path);
+		return false;
+	}
+	return true;
+}
+
+void Logger::CloseBinaryLog() {
+	Flush();
+	LogBackend::Get()->CloseBinaryLog();
+}
+
+const char* Logger::GetLevelName(LogLevel level) {
+	switch (level) {
+		case LogLevel::Trace: return "TRC";
+		case LogLevel::Debug: return "DBG";
+		case LogLevel::Info: return "LOG";
+		case LogLevel::Warning: return "WRN";
+		case LogLevel::Error: return "ERR";
+	}
+	return "???";
+}
 
-	messages.push_back(logEntry);
+const char* Logger::GetCategoryName(LogCategory category) {
+	switch (category) {
+		case LogCategory::General: return "General";
+		case LogCategory::ECS: return "ECS";
+		case LogCategory::Systems: return "Systems";
+		case LogCategory::Assets: return "Assets";
+		case LogCategory::Game: return "Game";
+		case LogCategory::Input: return "Input";
+		case LogCategory::Count: break;
+	}
+	return "???";
 }
 
 const std::string Logger::GetCurrentTimeStampString(const std::chrono::system_clock::time_point now) {
 	std::time_t timestamp = std::chrono::system_clock::to_time_t(now);
-	std::string now_str(32, '\0');
-	strftime(&now_str[0], 32, "%d-%b-%Y %H:%M:%S - ", localtime(&timestamp));
-	return now_str;
+	char now_str[32];
+	const size_t length = strftime(now_str, sizeof(now_str), "%d-%b-%Y %H:%M:%S - ", localtime(&timestamp));
+	return std::string(now_str, length);
 }
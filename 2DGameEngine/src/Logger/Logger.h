@@ -10,25 +10,197 @@
 #include <string>
 #include <chrono>
 #include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <atomic>
 
-enum LogType {
-	LOG_INFO,
-	LOG_WARNING,
-	LOG_ERROR
+// Lowest level compiled in, calls below it are removed entirely. 0 = trace ... 4 = error
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL 2
+#else
+#define LOG_MIN_LEVEL 0
+#endif
+#endif
+
+enum class LogLevel : uint8_t {
+	Trace,
+	Debug,
+	Info,
+	Warning,
+	Error
+};
+
+// Every category has its own runtime level, see Logger::SetLevel
+enum class LogCategory : uint8_t {
+	General,
+	ECS,
+	Systems,
+	Assets,
+	Game,
+	Input,
+	Count
 };
 
 struct LogEntry {
-	LogType type;
+	LogLevel type;
 	std::string msg;
 	std::chrono::system_clock::time_point msg_timestamp_timePoint;
 };
 
+// One log call on its way from the calling thread to the logging thread.
+// The arguments are copied in raw and only turned into text on the logging thread
+struct LogRecord {
+	static constexpr int SIZE = 256;
+	static constexpr int PAYLOAD_SIZE = SIZE - 22;
+
+	enum ArgumentType : uint8_t {
+		ARGUMENT_INT,
+		ARGUMENT_UINT,
+		ARGUMENT_DOUBLE,
+		ARGUMENT_BOOL,
+		ARGUMENT_CHAR,
+		ARGUMENT_STRING
+	};
+
+	// system_clock ticks
+	int64_t timestamp;
+	// String literal of the call site, its address doubles as the format id.
+	// "{}" marks where the next argument goes
+	const char* format;
+	uint16_t payloadSize;
+	uint8_t numArguments;
+	// Set when the arguments didn't all fit in the payload
+	uint8_t isTruncated;
+	LogLevel level;
+	LogCategory category;
+	char payload[PAYLOAD_SIZE];
+
+	template <typename T> void Append(const T& value);
+	void AppendString(const char* text, size_t length);
+private:
+	void AppendRaw(ArgumentType type, const void* value, size_t size);
+};
+
+static_assert(sizeof(LogRecord) == LogRecord::SIZE, "LogRecord must stay one fixed size slot");
+
+// Log calls only copy a record into a lock free ring owned by the calling thread.
+// A background thread picks the records up, formats them and writes them out.
 class Logger {
 private:
-	static std::vector<LogEntry> messages;
+	static std::atomic<uint8_t> categoryLevels[static_cast<int>(LogCategory::Count)];
 	static const std::string GetCurrentTimeStampString(const std::chrono::system_clock::time_point now);
+
+	// nullptr if the message can't be logged (the logging thread stopped with the ring full)
+	static LogRecord* BeginRecord(LogLevel level, LogCategory category, const char* format);
+	static void EndRecord(LogRecord* record);
+
+	friend class LogBackend;
 public:
 	static void Log(const std::string& msg);
 	static void Err(const std::string& msg);
+
+	// Logs format with args substituted for its "{}"s, without allocating on the calling thread.
+	// format has to be a string literal, only its address is stored. Use the LOG_* macros below
+	template <size_t N, typename ...TArgs>
+	static void Write(LogLevel level, LogCategory category, const char (&format)[N], const TArgs& ...args);
+
+	static void SetLevel(LogCategory category, LogLevel level) {
+		categoryLevels[static_cast<int>(category)].store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+	}
+
+	static LogLevel GetLevel(LogCategory category) {
+		return static_cast<LogLevel>(categoryLevels[static_cast<int>(category)].load(std::memory_order_relaxed));
+	}
+
+	static constexpr bool IsCompiledIn(LogLevel level) {
+		return static_cast<int>(level) - LOG_MIN_LEVEL >= 0;
+	}
+
+	static bool IsEnabled(LogCategory category, LogLevel level) {
+		return static_cast<uint8_t>(level) >= categoryLevels[static_cast<int>(category)].load(std::memory_order_relaxed);
+	}
+
+	static const char* GetLevelName(LogLevel level);
+	static const char* GetCategoryName(LogCategory category);
+
+	// The last HISTORY_CAPACITY messages are kept for the in game console
+	static constexpr int HISTORY_CAPACITY = 1024;
+	// Copies the kept messages into entries, oldest first
+	static void GetHistory(std::vector<LogEntry>& entries);
+
+	// Messages lost since startup (logged after shutdown, or the binary log was full)
+	static uint64_t GetNumDropped();
+	// Times a thread logged faster than the logging thread could keep up and had to wait
+	static uint64_t GetNumStalls();
+
+	// Also writes every message to a binary file (see LogFile), capacity bytes are preallocated
+	static bool OpenBinaryLog(const std::string& path, size_t capacity);
+	static void CloseBinaryLog();
+
+	// Appends the text of record to text, the way it is shown on the console.
+	// false if the record is malformed (bad level, category or arguments), text may hold part of it then
+	static bool FormatEntry(const LogRecord& record, std::string& text);
+
+	// Blocks until everything logged so far has been written out
+	static void Flush();
 };
-#endif
\ No newline at end of file
+
+template <typename T>
+void LogRecord::Append(const T& value) {
+	using TValue = std::decay_t<T>;
+
+	if constexpr (std::is_same_v<TValue, bool>) {
+		AppendRaw(ARGUMENT_BOOL, &value, sizeof(bool));
+	} else if constexpr (std::is_same_v<TValue, char>) {
+		AppendRaw(ARGUMENT_CHAR, &value, sizeof(char));
+	} else if constexpr (std::is_enum_v<TValue>) {
+		const int64_t integer = static_cast<int64_t>(value);
+		AppendRaw(ARGUMENT_INT, &integer, sizeof(integer));
+	} else if constexpr (std::is_integral_v<TValue> && std::is_signed_v<TValue>) {
+		const int64_t integer = value;
+		AppendRaw(ARGUMENT_INT, &integer, sizeof(integer));
+	} else if constexpr (std::is_integral_v<TValue>) {
+		const uint64_t integer = value;
+		AppendRaw(ARGUMENT_UINT, &integer, sizeof(integer));
+	} else if constexpr (std::is_floating_point_v<TValue>) {
+		const double number = value;
+		AppendRaw(ARGUMENT_DOUBLE, &number, sizeof(number));
+	} else if constexpr (std::is_same_v<TValue, std::string>) {
+		AppendString(value.data(), value.size());
+	} else if constexpr (std::is_same_v<TValue, const char*> || std::is_same_v<TValue, char*>) {
+		AppendString(value, value ? std::strlen(value) : 0);
+	} else {
+		static_assert(std::is_same_v<TValue, void>, "Type can't be logged, convert it to a number or a string first");
+	}
+}
+
+template <size_t N, typename ...TArgs>
+void Logger::Write(LogLevel level, LogCategory category, const char (&format)[N], const TArgs& ...args) {
+	LogRecord* record = BeginRecord(level, category, format);
+	if (!record) {
+		return;
+	}
+
+	(record->Append(args), ...);
+	EndRecord(record);
+}
+
+// The arguments are only evaluated when the message passes both the compile time and the category level,
+// below LOG_MIN_LEVEL the whole call compiles away.
+// LOG_INFO(LogCategory::ECS, "Entity created with id = {}", entityId);
+#define LOG_WRITE(level, category, ...) \
+	do { \
+		if (Logger::IsCompiledIn(level) && Logger::IsEnabled(category, level)) { \
+			Logger::Write(level, category, __VA_ARGS__); \
+		} \
+	} while (false)
+
+#define LOG_TRACE(category, ...) LOG_WRITE(LogLevel::Trace, category, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG_WRITE(LogLevel::Debug, category, __VA_ARGS__)
+#define LOG_INFO(category, ...) LOG_WRITE(LogLevel::Info, category, __VA_ARGS__)
+#define LOG_WARN(category, ...) LOG_WRITE(LogLevel::Warning, category, __VA_ARGS__)
+#define LOG_ERR(category, ...) LOG_WRITE(LogLevel::Error, category, __VA_ARGS__)
+
+#endif
@@ -1,11 +1,69 @@
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include "./Game/Game.h"
+#include "./Logger/Logger.h"
+#include "./Logger/LogFile.h"
+#include "./Memory/MemoryTracker.h"
 
 int main(int argc, char* argv[]) {
-	Game game;
+	GameOptions options;
 
-	game.Initialize();
-	game.Run();
-	game.Destroy();
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--binary-log") == 0 && i + 1 < argc) {
+			// --binary-log <path>: also write the log to a binary file, LogDecoder turns it back into text
+			Logger::OpenBinaryLog(argv[++i], LogFile::DEFAULT_CAPACITY);
+		} else if (std::strcmp(argv[i], "--headless") == 0) {
+			// --headless: no window or renderer, simulate with a fixed dt as fast as possible
+			options.isHeadless = true;
+		} else if (std::strcmp(argv[i], "--fixed-dt") == 0 && i + 1 < argc) {
+			// --fixed-dt <seconds>: the dt a headless run steps with. atof gives 0 for a typo,
+			// and a dt of 0 would never add up to a simulation step
+			const double fixedDeltaTime = std::atof(argv[++i]);
+			if (fixedDeltaTime > 0.0) {
+				options.fixedDeltaTime = fixedDeltaTime;
+			} else {
+				LOG_WARN(LogCategory::Game, "Ignoring --fixed-dt {}, it has to be more than 0 seconds. Using {}", argv[i], options.fixedDeltaTime);
+			}
+		} else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			// --frames <n>: quit after n frames
+			options.maxFrames = std::atoi(argv[++i]);
+		} else if (std::strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+			// --tick-rate <hz>: simulation steps per second
+			options.tickRate = std::max(std::atoi(argv[++i]), 1);
+		} else if (std::strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+			// --max-steps <n>: most simulation steps one frame catches up on
+			options.maxStepsPerFrame = std::max(std::atoi(argv[++i]), 1);
+		} else if (std::strcmp(argv[i], "--serial") == 0) {
+			// --serial: simulate and draw one after the other on the main thread
+			options.isPipelined = false;
+		} else if (std::strcmp(argv[i], "--fps-cap") == 0 && i + 1 < argc) {
+			// --fps-cap <n>: hold the frame rate to n, 0 for uncapped
+			options.frameRateCap = std::max(std::atoi(argv[++i]), 0);
+		} else if (std::strcmp(argv[i], "--record-input") == 0 && i + 1 < argc) {
+			// --record-input <path>: record every frame's input and dt for --replay-input
+			options.recordInputPath = argv[++i];
+		} else if (std::strcmp(argv[i], "--replay-input") == 0 && i + 1 < argc) {
+			// --replay-input <path>: play a recording back instead of reading live input, quits when it ends
+			options.replayInputPath = argv[++i];
+		} else if (std::strcmp(argv[i], "--stats-page") == 0) {
+			// --stats-page [name]: publish the engine counters to shared memory, StatsMonitor reads them
+			options.statsPageName = i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0 ? argv[++i] : StatsPage::DEFAULT_NAME;
+		}
+	}
+
+	{
+		Game game(options);
+
+		game.Initialize();
+		game.Run();
+		game.Destroy();
+	}
+
+	// After the game is gone, so anything still live here outlived it
+	MemoryTracker::Dump();
+
+	Logger::CloseBinaryLog();
 
 	return 0;
 }
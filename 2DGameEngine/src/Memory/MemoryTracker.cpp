@@ -0,0 +1,113 @@
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include "MemoryTracker.h"
+#include "../Logger/Logger.h"
+
+// Plain arrays of atomics, zero initialized before any constructor runs
+struct TagCounters {
+	std::atomic<int64_t> liveBytes;
+	std::atomic<int64_t> peakBytes;
+	std::atomic<uint64_t> numAllocations;
+};
+
+static TagCounters tagCounters[MemoryTracker::MAX_TAGS];
+
+static const char* const BUILTIN_TAG_NAMES[] = {
+	"Untagged",
+	"Entity signatures",
+	"System entity lists",
+	"Textures",
+	"Logger",
+	"Binary log"
+};
+
+static_assert(sizeof(BUILTIN_TAG_NAMES) / sizeof(BUILTIN_TAG_NAMES[0]) == static_cast<size_t>(MemoryTag::Count),
+	"Add the new tag to BUILTIN_TAG_NAMES");
+
+// Names of the registered tags, guarded by registerMutex
+static constexpr size_t MAX_TAG_NAME = 64;
+static char registeredTagNames[MemoryTracker::MAX_TAGS][MAX_TAG_NAME];
+static std::mutex registerMutex;
+static std::atomic<int> numTags{ static_cast<int>(MemoryTag::Count) };
+
+MemoryTag MemoryTracker::RegisterTag(const std::string& name) {
+	std::lock_guard<std::mutex> lock(registerMutex);
+
+	const int count = numTags.load(std::memory_order_relaxed);
+	for (int i = static_cast<int>(MemoryTag::Count); i < count; i++) {
+		if (name.compare(0, MAX_TAG_NAME - 1, registeredTagNames[i]) == 0) {
+			return static_cast<MemoryTag>(i);
+		}
+	}
+
+	if (count == MAX_TAGS) {
+		LOG_WARN(LogCategory::General, "Out of memory tags, {} is counted as untagged", name);
+		return MemoryTag::Untagged;
+	}
+
+	std::strncpy(registeredTagNames[count], name.c_str(), MAX_TAG_NAME - 1);
+	numTags.store(count + 1, std::memory_order_release);
+	return static_cast<MemoryTag>(count);
+}
+
+void MemoryTracker::Allocate(MemoryTag tag, size_t bytes) {
+	auto& counters = tagCounters[static_cast<int>(tag)];
+	const int64_t live = counters.liveBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+	counters.numAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	int64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+	}
+}
+
+void MemoryTracker::Free(MemoryTag tag, size_t bytes) {
+	tagCounters[static_cast<int>(tag)].liveBytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
+MemoryStats MemoryTracker::GetStats(MemoryTag tag) {
+	const int index = static_cast<int>(tag);
+	const auto& counters = tagCounters[index];
+
+	MemoryStats stats;
+	if (index < static_cast<int>(MemoryTag::Count)) {
+		stats.name = BUILTIN_TAG_NAMES[index];
+	} else {
+		std::lock_guard<std::mutex> lock(registerMutex);
+		stats.name = registeredTagNames[index];
+	}
+	stats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	stats.numAllocations = counters.numAllocations.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void MemoryTracker::GetStats(std::vector<MemoryStats>& stats) {
+	stats.clear();
+
+	const int count = numTags.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++) {
+		// Nothing should be untagged, only show it when something is
+		if (i == static_cast<int>(MemoryTag::Untagged) && tagCounters[i].numAllocations.load(std::memory_order_relaxed) == 0) {
+			continue;
+		}
+		stats.push_back(GetStats(static_cast<MemoryTag>(i)));
+	}
+}
+
+void MemoryTracker::Dump() {
+	std::vector<MemoryStats> stats;
+	GetStats(stats);
+
+	int64_t totalLive = 0;
+	int64_t totalPeak = 0;
+	for (const auto& tagStats : stats) {
+		LOG_INFO(LogCategory::General, "Memory {}: {} bytes live, {} bytes peak, {} allocations",
+			tagStats.name, tagStats.liveBytes, tagStats.peakBytes, tagStats.numAllocations);
+		totalLive += tagStats.liveBytes;
+		totalPeak += tagStats.peakBytes;
+	}
+
+	// The peaks of different tags need not have happened at the same time, so their sum is an upper bound
+	LOG_INFO(LogCategory::General, "Memory total: {} bytes live, at most {} bytes peak", totalLive, totalPeak);
+}
@@ -0,0 +1,106 @@
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+// What a block of memory is used for. The named tags are fixed,
+// MemoryTracker::RegisterTag hands out more of them at runtime (one per component pool)
+enum class MemoryTag : uint16_t {
+	Untagged,
+	// Registry::entityComponentSignatures and the rematch scratch space
+	Signatures,
+	// Entity lists of the systems
+	SystemLists,
+	// AssetStore textures, estimated from width * height * bytes per pixel
+	Textures,
+	// Log rings and history
+	Logger,
+	// Preallocated binary log mapping
+	LogFile,
+	Count
+};
+
+struct MemoryStats {
+	std::string name;
+	int64_t liveBytes;
+	int64_t peakBytes;
+	uint64_t numAllocations;
+};
+
+// Live and peak bytes per MemoryTag.
+// Counting is a couple of relaxed atomics per allocation and safe from any thread.
+// All state is zero initialized so it can be used during static initialization and destruction.
+class MemoryTracker {
+public:
+	static constexpr int MAX_TAGS = 128;
+
+	// Tag named name, the same name always gets the same tag. Falls back to Untagged when the tags run out
+	static MemoryTag RegisterTag(const std::string& name);
+
+	static void Allocate(MemoryTag tag, size_t bytes);
+	static void Free(MemoryTag tag, size_t bytes);
+
+	// Every tag that was used or registered, overwrites stats
+	static void GetStats(std::vector<MemoryStats>& stats);
+	static MemoryStats GetStats(MemoryTag tag);
+
+	// Logs a table of GetStats
+	static void Dump();
+};
+
+// Allocator that counts what it hands out against a tag.
+// Stateful: containers using it have to be given the tag when they are constructed
+//
+//	TrackedVector<Signature> signatures{ TrackingAllocator<Signature>(MemoryTag::Signatures) };
+template <typename T>
+class TrackingAllocator {
+private:
+	MemoryTag tag;
+
+	template <typename U> friend class TrackingAllocator;
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	explicit TrackingAllocator(MemoryTag tag) : tag(tag) {}
+
+	template <typename U>
+	TrackingAllocator(const TrackingAllocator<U>& other) : tag(other.tag) {}
+
+	T* allocate(size_t n) {
+		MemoryTracker::Allocate(tag, n * sizeof(T));
+		if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+			return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+		} else {
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+	}
+
+	void deallocate(T* pointer, size_t n) {
+		MemoryTracker::Free(tag, n * sizeof(T));
+		if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+			::operator delete(pointer, std::align_val_t(alignof(T)));
+		} else {
+			::operator delete(pointer);
+		}
+	}
+
+	MemoryTag GetTag() const { return tag; }
+
+	template <typename U>
+	bool operator ==(const TrackingAllocator<U>& other) const { return tag == other.tag; }
+	template <typename U>
+	bool operator !=(const TrackingAllocator<U>& other) const { return tag != other.tag; }
+};
+
+template <typename T>
+using TrackedVector = std::vector<T, TrackingAllocator<T>>;
+
+#endif
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <imgui/imgui.h>
+#include <imgui/imgui_sdl.h>
+#include "PerformanceOverlay.h"
+#include "../Profiler/Profiler.h"
+
+static double TicksToMilliseconds(uint64_t ticks) {
+	return Profiler::TicksToMicroseconds(ticks) / 1000.0;
+}
+
+static ImVec4 GetLogLevelColor(LogLevel level) {
+	switch (level) {
+	case LogLevel::Trace: return ImVec4(0.6f, 0.6f, 0.6f, 1.0f);
+	case LogLevel::Debug: return ImVec4(0.5f, 0.8f, 1.0f, 1.0f);
+	case LogLevel::Info: return ImVec4(0.5f, 1.0f, 0.5f, 1.0f);
+	case LogLevel::Warning: return ImVec4(1.0f, 0.8f, 0.3f, 1.0f);
+	case LogLevel::Error: return ImVec4(1.0f, 0.4f, 0.4f, 1.0f);
+	}
+	return ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+PerformanceOverlay::~PerformanceOverlay() {
+	Destroy();
+}
+
+void PerformanceOverlay::Initialize(SDL_Renderer* renderer, int windowWidth, int windowHeight) {
+	if (isInitialized) {
+		return;
+	}
+
+	ImGui::CreateContext();
+	// Window positions are not worth an imgui.ini next to the game
+	ImGuiIO& io = ImGui::GetIO();
+	io.IniFilename = nullptr;
+
+	// io.KeysDown is indexed by SDL scancode, the keys the text boxes use
+	io.KeyMap[ImGuiKey_Tab] = SDL_SCANCODE_TAB;
+	io.KeyMap[ImGuiKey_LeftArrow] = SDL_SCANCODE_LEFT;
+	io.KeyMap[ImGuiKey_RightArrow] = SDL_SCANCODE_RIGHT;
+	io.KeyMap[ImGuiKey_UpArrow] = SDL_SCANCODE_UP;
+	io.KeyMap[ImGuiKey_DownArrow] = SDL_SCANCODE_DOWN;
+	io.KeyMap[ImGuiKey_PageUp] = SDL_SCANCODE_PAGEUP;
+	io.KeyMap[ImGuiKey_PageDown] = SDL_SCANCODE_PAGEDOWN;
+	io.KeyMap[ImGuiKey_Home] = SDL_SCANCODE_HOME;
+	io.KeyMap[ImGuiKey_End] = SDL_SCANCODE_END;
+	io.KeyMap[ImGuiKey_Insert] = SDL_SCANCODE_INSERT;
+	io.KeyMap[ImGuiKey_Delete] = SDL_SCANCODE_DELETE;
+	io.KeyMap[ImGuiKey_Backspace] = SDL_SCANCODE_BACKSPACE;
+	io.KeyMap[ImGuiKey_Space] = SDL_SCANCODE_SPACE;
+	io.KeyMap[ImGuiKey_Enter] = SDL_SCANCODE_RETURN;
+	io.KeyMap[ImGuiKey_Escape] = SDL_SCANCODE_ESCAPE;
+	io.KeyMap[ImGuiKey_KeyPadEnter] = SDL_SCANCODE_KP_ENTER;
+	io.KeyMap[ImGuiKey_A] = SDL_SCANCODE_A;
+	io.KeyMap[ImGuiKey_C] = SDL_SCANCODE_C;
+	io.KeyMap[ImGuiKey_V] = SDL_SCANCODE_V;
+	io.KeyMap[ImGuiKey_X] = SDL_SCANCODE_X;
+	io.KeyMap[ImGuiKey_Y] = SDL_SCANCODE_Y;
+	io.KeyMap[ImGuiKey_Z] = SDL_SCANCODE_Z;
+
+	ImGuiSDL::Initialize(renderer, windowWidth, windowHeight);
+	isInitialized = true;
+}
+
+void PerformanceOverlay::Destroy() {
+	if (!isInitialized) {
+		return;
+	}
+
+	ImGuiSDL::Deinitialize();
+	isBuilt = false;
+	ImGui::DestroyContext();
+	isInitialized = false;
+}
+
+void PerformanceOverlay::Toggle() {
+	isVisible = !isVisible;
+
+	// Keys held when the overlay closes would still be down when it opens again
+	if (!isVisible && isInitialized) {
+		ImGuiIO& io = ImGui::GetIO();
+		std::fill(std::begin(io.KeysDown), std::end(io.KeysDown), false);
+		io.KeyCtrl = io.KeyShift = io.KeyAlt = io.KeySuper = false;
+	}
+}
+
+bool PerformanceOverlay::IsCapturingKeyboard() const {
+	// Set by the last Build, stale while the overlay is hidden
+	return isVisible && isInitialized && ImGui::GetIO().WantCaptureKeyboard;
+}
+
+void PerformanceOverlay::ProcessEvent(const SDL_Event& event) {
+	if (!isVisible || !isInitialized) {
+		return;
+	}
+
+	ImGuiIO& io = ImGui::GetIO();
+	switch (event.type) {
+	case SDL_MOUSEWHEEL:
+		mouseWheel += static_cast<float>(event.wheel.y);
+		break;
+	case SDL_TEXTINPUT:
+		io.AddInputCharactersUTF8(event.text.text);
+		break;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP: {
+		const int scancode = event.key.keysym.scancode;
+		if (scancode >= 0 && scancode < IM_ARRAYSIZE(io.KeysDown)) {
+			io.KeysDown[scancode] = event.type == SDL_KEYDOWN;
+		}
+		const SDL_Keymod modifiers = SDL_GetModState();
+		io.KeyShift = (modifiers & KMOD_SHIFT) != 0;
+		io.KeyCtrl = (modifiers & KMOD_CTRL) != 0;
+		io.KeyAlt = (modifiers & KMOD_ALT) != 0;
+		io.KeySuper = (modifiers & KMOD_GUI) != 0;
+		break;
+	}
+	}
+}
+
+void PerformanceOverlay::RecordUpdate(double deltaTime, uint64_t ticks) {
+	lastDeltaTime = deltaTime;
+	updateTicks = ticks;
+
+	frameTimes[nextFrame] = static_cast<float>(deltaTime * 1000.0);
+	nextFrame = (nextFrame + 1) % FRAME_HISTORY;
+	numFrames = std::min(numFrames + 1, FRAME_HISTORY);
+}
+
+void PerformanceOverlay::Build(const Registry& registry, const SystemScheduler& systemScheduler, const AssetStore& assetStore) {
+	if (!isVisible || !isInitialized) {
+		isBuilt = false;
+		return;
+	}
+
+	PROFILE_SCOPE("PerformanceOverlay::Build");
+
+	ImGuiIO& io = ImGui::GetIO();
+	io.DeltaTime = std::max(static_cast<float>(lastDeltaTime), 0.0001f);
+
+	int mouseX;
+	int mouseY;
+	const Uint32 buttons = SDL_GetMouseState(&mouseX, &mouseY);
+	io.MousePos = ImVec2(static_cast<float>(mouseX), static_cast<float>(mouseY));
+	io.MouseDown[0] = (buttons & SDL_BUTTON(SDL_BUTTON_LEFT)) != 0;
+	io.MouseDown[1] = (buttons & SDL_BUTTON(SDL_BUTTON_RIGHT)) != 0;
+	io.MouseWheel = mouseWheel;
+	mouseWheel = 0.0f;
+
+	ImGui::NewFrame();
+
+	ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowSize(ImVec2(460.0f, 560.0f), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowBgAlpha(0.85f);
+	if (ImGui::Begin("Performance (F1)")) {
+		DrawFrameTimes();
+		DrawSystems(registry, systemScheduler);
+		DrawEntities(registry);
+		DrawTextures(assetStore);
+		DrawMemory();
+		DrawLog();
+	}
+	ImGui::End();
+
+	ImGui::Render();
+	isBuilt = true;
+}
+
+void PerformanceOverlay::Render() {
+	if (!isBuilt) {
+		return;
+	}
+
+	PROFILE_SCOPE("PerformanceOverlay::Render");
+	ImGuiSDL::Render(ImGui::GetDrawData());
+}
+
+void PerformanceOverlay::DrawFrameTimes() {
+	if (!ImGui::CollapsingHeader("Frame", ImGuiTreeNodeFlags_DefaultOpen)) {
+		return;
+	}
+
+	float total = 0.0f;
+	float longest = 0.0f;
+	for (int i = 0; i < numFrames; i++) {
+		total += frameTimes[i];
+		longest = std::max(longest, frameTimes[i]);
+	}
+	const float average = numFrames > 0 ? total / numFrames : 0.0f;
+
+	char summary[96];
+	std::snprintf(summary, sizeof(summary), "avg %.2f ms (%.0f FPS), max %.2f ms", average, average > 0.0f ? 1000.0f / average : 0.0f, longest);
+
+	// Until the history is full the oldest entries are still zero, start the graph at the oldest real frame
+	const int offset = numFrames < FRAME_HISTORY ? 0 : nextFrame;
+	ImGui::PlotLines("##FrameTimes", frameTimes, numFrames, offset, summary, 0.0f, std::max(longest * 1.2f, 1.0f), ImVec2(-1.0f, 80.0f));
+
+	ImGui::Text("Update %.3f ms   Render %.3f ms", TicksToMilliseconds(updateTicks), TicksToMilliseconds(renderTicks));
+	if (pacingStats.numFrames > 0) {
+		ImGui::Text("Pacing error %.0f us (std dev %.0f, max %.0f)   Late frames %d",
+			pacingStats.meanErrorMicroseconds, pacingStats.stdDevErrorMicroseconds, pacingStats.maxErrorMicroseconds, pacingStats.numLateFrames);
+	}
+}
+
+void PerformanceOverlay::DrawSystems(const Registry& registry, const SystemScheduler& systemScheduler) {
+	if (!ImGui::CollapsingHeader("Systems", ImGuiTreeNodeFlags_DefaultOpen)) {
+		return;
+	}
+
+	const auto& timings = systemScheduler.GetLastTimings();
+
+	ImGui::Columns(5, "Systems");
+	ImGui::Text("System"); ImGui::NextColumn();
+	ImGui::Text("Entities"); ImGui::NextColumn();
+	ImGui::Text("Wall ms"); ImGui::NextColumn();
+	ImGui::Text("Busy ms"); ImGui::NextColumn();
+	ImGui::Text("Ranges"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	for (const System* system : registry.GetSystems()) {
+		ImGui::TextUnformatted(system->GetName().c_str()); ImGui::NextColumn();
+		ImGui::Text("%d", static_cast<int>(system->GetSystemEntities().size())); ImGui::NextColumn();
+
+		auto timing = std::find_if(timings.begin(), timings.end(), [system](const SystemScheduler::SystemTiming& timing) {
+			return timing.system == system;
+		});
+		if (timing != timings.end()) {
+			ImGui::Text("%.3f", TicksToMilliseconds(timing->wallTicks)); ImGui::NextColumn();
+			ImGui::Text("%.3f", TicksToMilliseconds(timing->busyTicks)); ImGui::NextColumn();
+			ImGui::Text("%d", timing->numRanges); ImGui::NextColumn();
+		} else {
+			// Not run through the scheduler (RenderSystem is timed as Render above)
+			ImGui::TextDisabled("-"); ImGui::NextColumn();
+			ImGui::TextDisabled("-"); ImGui::NextColumn();
+			ImGui::TextDisabled("-"); ImGui::NextColumn();
+		}
+	}
+
+	ImGui::Columns(1);
+	ImGui::Text("Job workers: %d", systemScheduler.GetNumWorkers());
+}
+
+void PerformanceOverlay::DrawEntities(const Registry& registry) {
+	if (!ImGui::CollapsingHeader("Entities", ImGuiTreeNodeFlags_DefaultOpen)) {
+		return;
+	}
+
+	const int numEntityIds = registry.GetNumEntityIds();
+	const int numEntities = registry.GetNumEntities();
+	ImGui::Text("Alive %d   Ids %d   Free ids %d", numEntities, numEntityIds, numEntityIds - numEntities);
+
+	const bool isArchetypes = registry.GetStorageMode() == StorageMode::Archetypes;
+	if (isArchetypes) {
+		ImGui::Text("Storage: archetypes (%d)", registry.GetArchetypeStorage().GetNumArchetypes());
+	} else {
+		ImGui::Text("Storage: component pools");
+	}
+
+	registry.GetStorageStats(storageStats);
+
+	ImGui::Columns(4, "Storage");
+	ImGui::TextUnformatted(isArchetypes ? "Archetype" : "Component"); ImGui::NextColumn();
+	ImGui::Text("Size / capacity"); ImGui::NextColumn();
+	ImGui::Text("Occupancy"); ImGui::NextColumn();
+	ImGui::Text("KB"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	char occupancy[32];
+	for (const auto& stats : storageStats) {
+		const float fraction = stats.capacity > 0 ? static_cast<float>(stats.size) / stats.capacity : 0.0f;
+		std::snprintf(occupancy, sizeof(occupancy), "%.0f%%", fraction * 100.0f);
+
+		ImGui::TextUnformatted(stats.name.c_str()); ImGui::NextColumn();
+		ImGui::Text("%d / %d", stats.size, stats.capacity); ImGui::NextColumn();
+		ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), occupancy); ImGui::NextColumn();
+		ImGui::Text("%.1f", static_cast<double>(stats.capacity) * stats.itemSize / 1024.0); ImGui::NextColumn();
+	}
+
+	ImGui::Columns(1);
+}
+
+void PerformanceOverlay::DrawTextures(const AssetStore& assetStore) {
+	if (!ImGui::CollapsingHeader("Textures", ImGuiTreeNodeFlags_DefaultOpen)) {
+		return;
+	}
+
+	ImGui::Text("Textures %d   Memory %.2f MB", assetStore.GetNumTextures(), assetStore.GetTextureMemory() / (1024.0 * 1024.0));
+}
+
+void PerformanceOverlay::DrawMemory() {
+	if (!ImGui::CollapsingHeader("Memory")) {
+		return;
+	}
+
+	MemoryTracker::GetStats(memoryStats);
+
+	ImGui::Columns(3, "Memory");
+	ImGui::Text("Tag"); ImGui::NextColumn();
+	ImGui::Text("Live KB"); ImGui::NextColumn();
+	ImGui::Text("Peak KB"); ImGui::NextColumn();
+	ImGui::Separator();
+
+	for (const auto& stats : memoryStats) {
+		ImGui::TextUnformatted(stats.name.c_str()); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats.liveBytes / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats.peakBytes / 1024.0); ImGui::NextColumn();
+	}
+
+	ImGui::Columns(1);
+}
+
+void PerformanceOverlay::DrawLog() {
+	if (!ImGui::CollapsingHeader("Log", ImGuiTreeNodeFlags_DefaultOpen)) {
+		return;
+	}
+
+	ImGui::PushItemWidth(100.0f);
+	ImGui::Combo("Level", &minLogLevel, "Trace\0Debug\0Info\0Warning\0Error\0");
+	ImGui::PopItemWidth();
+	ImGui::SameLine();
+	ImGui::PushItemWidth(150.0f);
+	ImGui::InputText("Filter", logFilter, sizeof(logFilter));
+	ImGui::PopItemWidth();
+	ImGui::SameLine();
+	ImGui::Checkbox("Auto scroll", &autoScrollLog);
+
+	Logger::GetHistory(logEntries);
+
+	ImGui::BeginChild("LogHistory", ImVec2(0.0f, 0.0f), true, ImGuiWindowFlags_HorizontalScrollbar);
+	for (const auto& entry : logEntries) {
+		if (static_cast<int>(entry.type) < minLogLevel) {
+			continue;
+		}
+		if (logFilter[0] != '\0' && entry.msg.find(logFilter) == std::string::npos) {
+			continue;
+		}
+
+		ImGui::PushStyleColor(ImGuiCol_Text, GetLogLevelColor(entry.type));
+		ImGui::TextUnformatted(entry.msg.c_str(), entry.msg.c_str() + entry.msg.size());
+		ImGui::PopStyleColor();
+	}
+
+	// Stick to the newest message unless the user scrolled up
+	if (autoScrollLog && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) {
+		ImGui::SetScrollHereY(1.0f);
+	}
+	ImGui::EndChild();
+}
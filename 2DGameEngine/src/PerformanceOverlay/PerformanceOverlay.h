@@ -0,0 +1,87 @@
+#ifndef PERFORMANCEOVERLAY_H
+#define PERFORMANCEOVERLAY_H
+
+#include <SDL.h>
+#include <vector>
+#include <cstdint>
+#include "../ECS/ECS.h"
+#include "../ECS/SystemScheduler.h"
+#include "../AssetStore/AssetStore.h"
+#include "../Logger/Logger.h"
+#include "../Memory/MemoryTracker.h"
+#include "../FramePacer/FramePacer.h"
+
+// ImGui window with the engine counters: frame times, system timings, entities, component pools,
+// textures, memory per tag and the log history.
+// The game hands it a couple of numbers every frame (RecordUpdate / RecordRender), everything else
+// is only read from the engine while the overlay is visible, so a hidden overlay costs next to nothing.
+class PerformanceOverlay {
+public:
+	// Frames shown in the frame time graph
+	static constexpr int FRAME_HISTORY = 240;
+
+private:
+	bool isInitialized = false;
+	bool isVisible = false;
+	// A Build is waiting to be drawn
+	bool isBuilt = false;
+
+	// Milliseconds, frameTimes[nextFrame] is the oldest frame
+	float frameTimes[FRAME_HISTORY] = {};
+	int nextFrame = 0;
+	int numFrames = 0;
+	double lastDeltaTime = 0.0;
+	// Profiler::Now ticks of the last Game::Update / RenderSystem
+	uint64_t updateTicks = 0;
+	uint64_t renderTicks = 0;
+	PacingStats pacingStats = {};
+
+	float mouseWheel = 0.0f;
+
+	// Log window settings
+	int minLogLevel = static_cast<int>(LogLevel::Trace);
+	char logFilter[64] = {};
+	bool autoScrollLog = true;
+
+	// Kept between frames so drawing doesn't allocate once they are big enough
+	std::vector<StorageStats> storageStats;
+	std::vector<MemoryStats> memoryStats;
+	std::vector<LogEntry> logEntries;
+
+	void DrawFrameTimes();
+	void DrawSystems(const Registry& registry, const SystemScheduler& systemScheduler);
+	void DrawEntities(const Registry& registry);
+	void DrawTextures(const AssetStore& assetStore);
+	void DrawMemory();
+	void DrawLog();
+public:
+	PerformanceOverlay() = default;
+	~PerformanceOverlay();
+	PerformanceOverlay(const PerformanceOverlay&) = delete;
+	PerformanceOverlay& operator =(const PerformanceOverlay&) = delete;
+
+	// Creates the ImGui context and its font texture, call once the renderer exists
+	void Initialize(SDL_Renderer* renderer, int windowWidth, int windowHeight);
+	// Call before the renderer is destroyed
+	void Destroy();
+
+	void Toggle();
+	bool IsVisible() const { return isVisible; }
+	// True while one of the overlay's text boxes has focus, the game should leave the keyboard alone then
+	bool IsCapturingKeyboard() const;
+
+	// Mouse wheel, keys and text typed into the overlay, ignored while it is hidden
+	void ProcessEvent(const SDL_Event& event);
+
+	void RecordUpdate(double deltaTime, uint64_t ticks);
+	void RecordRender(uint64_t ticks) { renderTicks = ticks; }
+	void RecordPacing(const PacingStats& stats) { pacingStats = stats; }
+
+	// Reads the engine and lays the overlay out, does nothing while it is hidden.
+	// Must not run while the simulation does, the game calls it where the two threads meet
+	void Build(const Registry& registry, const SystemScheduler& systemScheduler, const AssetStore& assetStore);
+	// Draws what the last Build laid out on top of the frame
+	void Render();
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include "Profiler.h"
+#include "../Logger/Logger.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_USE_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_USE_RDTSC 1
+#endif
+
+// Zones of one thread. Only the owning thread writes, the trace writer reads up to numEvents
+struct ProfileThread {
+	std::unique_ptr<ProfileEvent[]> events;
+	// Total number of zones ever written, events[numEvents % EVENTS_PER_THREAD] is the next slot
+	std::atomic<uint64_t> numEvents{ 0 };
+	uint32_t depth = 0;
+	uint32_t id = 0;
+	// Guarded by threadsMutex
+	std::string name;
+};
+
+static std::mutex threadsMutex;
+static std::vector<std::unique_ptr<ProfileThread>> threads;
+static thread_local ProfileThread* currentThread = nullptr;
+
+static ProfileThread* GetCurrentThread() {
+	if (!currentThread) {
+		auto thread = std::make_unique<ProfileThread>();
+		thread->events.reset(new ProfileEvent[Profiler::EVENTS_PER_THREAD]);
+
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		thread->id = static_cast<uint32_t>(threads.size()) + 1;
+		thread->name = "Thread " + std::to_string(thread->id);
+		currentThread = thread.get();
+		threads.push_back(std::move(thread));
+	}
+	return currentThread;
+}
+
+// Pairs of (ticks, steady_clock) used to work out the tick rate when a trace is written
+struct ClockCalibration {
+	uint64_t ticks;
+	std::chrono::steady_clock::time_point time;
+};
+
+static const ClockCalibration startCalibration = { Profiler::Now(), std::chrono::steady_clock::now() };
+
+// Frame and capture state, only touched by the thread running the game loop
+static uint64_t frameBegin = 0;
+static int captureFramesRequested = 0;
+static int captureFramesLeft = 0;
+static uint64_t captureBegin = 0;
+static std::string capturePath;
+
+static void WriteTrace(const std::string& path, uint64_t begin, uint64_t end, int numFrames);
+
+uint64_t Profiler::Now() {
+#ifdef PROFILER_USE_RDTSC
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+double Profiler::TicksToMicroseconds(uint64_t ticks) {
+#ifdef PROFILER_USE_RDTSC
+	// The longer the game ran the better the estimate of the tsc rate
+	const uint64_t elapsedTicks = Now() - startCalibration.ticks;
+	const double elapsedMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startCalibration.time).count();
+	if (elapsedTicks == 0 || elapsedMicroseconds <= 0.0) {
+		return 0.0;
+	}
+	return static_cast<double>(ticks) * elapsedMicroseconds / static_cast<double>(elapsedTicks);
+#else
+	return static_cast<double>(ticks) / 1000.0;
+#endif
+}
+
+void Profiler::BeginZone() {
+	GetCurrentThread()->depth++;
+}
+
+void Profiler::EndZone(const char* name, uint64_t begin, uint64_t end) {
+	ProfileThread* thread = GetCurrentThread();
+	thread->depth--;
+
+	const uint64_t index = thread->numEvents.load(std::memory_order_relaxed);
+	thread->events[index % EVENTS_PER_THREAD] = { name, begin, end, thread->depth };
+	thread->numEvents.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+	ProfileThread* thread = GetCurrentThread();
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	thread->name = name;
+}
+
+void Profiler::BeginFrame() {
+	BeginZone();
+	frameBegin = Now();
+
+	if (captureFramesRequested > 0 && captureFramesLeft == 0) {
+		captureFramesLeft = captureFramesRequested;
+		captureBegin = frameBegin;
+	}
+}
+
+void Profiler::EndFrame() {
+	EndZone("Frame", frameBegin, Now());
+
+	if (captureFramesLeft > 0 && --captureFramesLeft == 0) {
+		WriteTrace(capturePath, captureBegin, Now(), captureFramesRequested);
+		captureFramesRequested = 0;
+	}
+}
+
+void Profiler::CaptureFrames(int numFrames, const std::string& path) {
+	if (IsCapturing() || numFrames <= 0) {
+		return;
+	}
+
+	captureFramesRequested = numFrames;
+	capturePath = path;
+	LOG_INFO(LogCategory::General, "Capturing {} frames to {}", numFrames, path);
+}
+
+bool Profiler::IsCapturing() {
+	return captureFramesRequested > 0;
+}
+
+static void AppendEscaped(std::string& json, const std::string& text) {
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			json += '\\';
+		}
+		json += c;
+	}
+}
+
+static void WriteTrace(const std::string& path, uint64_t begin, uint64_t end, int numFrames) {
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	int numZones = 0;
+	char number[64];
+
+	{
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		for (const auto& thread : threads) {
+			json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread->id) + ",\"args\":{\"name\":\"";
+			AppendEscaped(json, thread->name);
+			json += "\"}},\n";
+
+			// Zones older than one ring may have been overwritten already
+			const uint64_t numEvents = thread->numEvents.load(std::memory_order_acquire);
+			const uint64_t first = numEvents > Profiler::EVENTS_PER_THREAD ? numEvents - Profiler::EVENTS_PER_THREAD : 0;
+
+			for (uint64_t i = first; i < numEvents; i++) {
+				const ProfileEvent& event = thread->events[i % Profiler::EVENTS_PER_THREAD];
+				if (event.end < begin || event.begin > end) {
+					continue;
+				}
+
+				json += "{\"name\":\"";
+				AppendEscaped(json, event.name);
+				std::snprintf(number, sizeof(number), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,", thread->id);
+				json += number;
+				std::snprintf(number, sizeof(number), "\"ts\":%.3f,", Profiler::TicksToMicroseconds(event.begin - std::min(event.begin, begin)));
+				json += number;
+				std::snprintf(number, sizeof(number), "\"dur\":%.3f},\n", Profiler::TicksToMicroseconds(event.end - event.begin));
+				json += number;
+				numZones++;
+			}
+		}
+	}
+
+	// JSON has no trailing commas, the process name metadata event closes the list
+	json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"2DGameEngine\"}}\n]}\n";
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		LOG_ERR(LogCategory::General, "Could not write trace to {}", path);
+		return;
+	}
+	file.write(json.data(), json.size());
+
+	LOG_INFO(LogCategory::General, "Wrote {} zones of {} frames ({} ms) to {}", numZones, numFrames,
+		Profiler::TicksToMicroseconds(end - begin) / 1000.0, path);
+}
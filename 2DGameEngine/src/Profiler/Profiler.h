@@ -0,0 +1,75 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <cstdint>
+
+// Set to 0 from the build to compile every PROFILE_SCOPE out
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// One finished zone, begin and end are in Profiler::Now ticks
+struct ProfileEvent {
+	const char* name;
+	uint64_t begin;
+	uint64_t end;
+	uint32_t depth;
+};
+
+// Records zones (PROFILE_SCOPE) into a preallocated ring per thread and can write
+// a number of frames of them out as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+class Profiler {
+public:
+	// Zones kept per thread, older ones are overwritten
+	static constexpr int EVENTS_PER_THREAD = 1 << 16;
+
+	// rdtsc where we have it, steady_clock otherwise
+	static uint64_t Now();
+	static double TicksToMicroseconds(uint64_t ticks);
+
+	// Called by ProfileScope
+	static void BeginZone();
+	static void EndZone(const char* name, uint64_t begin, uint64_t end);
+
+	// Shows up as the thread name in the trace
+	static void SetThreadName(const std::string& name);
+
+	// Frame boundaries, the game loop calls these once per frame
+	static void BeginFrame();
+	static void EndFrame();
+
+	// Writes the next numFrames frames to path once they are done
+	static void CaptureFrames(int numFrames, const std::string& path);
+	static bool IsCapturing();
+};
+
+class ProfileScope {
+private:
+	const char* name;
+	uint64_t begin;
+public:
+	// name has to outlive the profiler, use string literals
+	explicit ProfileScope(const char* name) : name(name) {
+		Profiler::BeginZone();
+		begin = Profiler::Now();
+	}
+
+	~ProfileScope() {
+		Profiler::EndZone(name, begin, Profiler::Now());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator =(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) do {} while (false)
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef RENDERSNAPSHOT_H
+#define RENDERSNAPSHOT_H
+
+#include <SDL.h>
+#include <vector>
+
+// One sprite, ready to hand to SDL_RenderCopyEx
+struct RenderCommand {
+	SDL_Texture* texture;
+	SDL_Rect srcRect;
+	SDL_Rect destRect;
+	double rotation;
+	int zIndex;
+};
+
+// Everything needed to draw one frame, in draw order. Built by the simulation (RenderSystem::BuildSnapshot)
+// and only read once it is published, so drawing it never touches the registry
+struct RenderSnapshot {
+	std::vector<RenderCommand> commands;
+};
+
+// Two snapshots: the simulation builds the back one while the front one is drawn.
+// Swap hands the back one over and must only be called while neither side is using its snapshot,
+// the game loop does it at the point where the simulation and render threads meet each frame.
+// The vectors keep their capacity, so after the first frames building a snapshot doesn't allocate.
+class RenderSnapshotBuffer {
+private:
+	RenderSnapshot snapshots[2];
+	int frontIndex = 0;
+public:
+	RenderSnapshot& GetBack() { return snapshots[1 - frontIndex]; }
+	const RenderSnapshot& GetFront() const { return snapshots[frontIndex]; }
+	void Swap() { frontIndex = 1 - frontIndex; }
+};
+
+#endif
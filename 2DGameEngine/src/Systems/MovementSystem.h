@@ -5,28 +5,39 @@
 #include "../Components/TransformComponent.h"
 #include "../Components/RigidBodyComponent.h"
 #include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
 
 class MovementSystem: public System {
 public:
 	MovementSystem() {
 		RequireComponent<TransformComponent>();
 		RequireComponent<RigidBodyComponent>();
+		WritesComponent<TransformComponent>();
+		ReadsComponent<RigidBodyComponent>();
 	}
-	void Update(double deltaTime) {
-		// TODO: 
-		// Loop over all entities that the system is interested in:
-		for (auto entity : GetSystemEntities()) {
-			auto& transform = entity.GetComponent<TransformComponent>();
-			auto& rigidbody = entity.GetComponent<RigidBodyComponent>();
-			
+
+	// Number of work items Update can be split into
+	int GetWorkSize(const Registry& registry) const {
+		return registry.EachSize<TransformComponent, RigidBodyComponent>();
+	}
+
+	void Update(Registry& registry, double deltaTime) {
+		Update(registry, deltaTime, 0, GetWorkSize(registry));
+	}
+
+	// Only updates work items [first, last), disjoint ranges can run on different threads
+	void Update(Registry& registry, double deltaTime, int first, int last) {
+		PROFILE_SCOPE("MovementSystem");
+
+		// Loop over all entities that have both a transform and a rigidbody
+		// EachInRange resolves the component storage once instead of on every GetComponent call
+		registry.EachInRange<TransformComponent, RigidBodyComponent>(first, last, [&registry, deltaTime](Entity entity, TransformComponent& transform, RigidBodyComponent& rigidbody) {
 			transform.position.x += rigidbody.velocity.x * deltaTime;
 			transform.position.y += rigidbody.velocity.y * deltaTime;
+			registry.MarkChanged<TransformComponent>(entity);
 
-			Logger::Log("Entity id = " + std::to_string(entity.GetId()) + 
-				" pos: " + 
-				std::to_string(transform.position.x) + ", " + 
-				std::to_string(transform.position.y));
-		}
+			LOG_TRACE(LogCategory::Systems, "Entity id = {} pos: {}, {}", entity.GetId(), transform.position.x, transform.position.y);
+		});
 	}
 };
 
@@ -4,51 +4,164 @@
 #include <algorithm>
 #include "../ECS/ECS.h"
 #include "../Components/TransformComponent.h"
+#include "../Components/PreviousTransformComponent.h"
 #include "../Components/SpriteComponent.h"
 #include "../AssetStore/AssetStore.h"
+#include "../Renderer/RenderSnapshot.h"
+#include "../Profiler/Profiler.h"
 #include "SDL.h"
 
 class RenderSystem : public System {
+private:
+	struct RenderItem {
+		int zIndex;
+		Entity entity;
+	};
+
+	// Kept sorted by zIndex between frames, only re-sorted when a sprite joins, leaves or changes zIndex
+	std::vector<RenderItem> renderItems;
+	// index = entityId, value = index in renderItems
+	std::vector<int> entityIdToRenderItem;
+	uint32_t sortedMembershipVersion = 0;
+	uint32_t lastRenderTick = 0;
+	bool hasSorted = false;
+
+	void RebuildRenderItems() {
+		renderItems.clear();
+		for (auto entity : GetSystemEntities()) {
+			renderItems.push_back({ entity.GetComponent<SpriteComponent>().zIndex, entity });
+		}
+
+		std::stable_sort(renderItems.begin(), renderItems.end(), [](const RenderItem& a, const RenderItem& b) {
+			return a.zIndex < b.zIndex;
+		});
+	}
+
+	// Only the sort keys of sprites changed since the last render are refreshed.
+	// Returns true if any zIndex actually changed
+	bool UpdateChangedSortKeys(Registry& registry) {
+		bool changed = false;
+		for (auto [entity, sprite] : registry.View<SpriteComponent>().Changed<SpriteComponent>(lastRenderTick)) {
+			if (!HasEntity(entity)) {
+				continue;
+			}
+
+			auto& item = renderItems[entityIdToRenderItem[entity.GetId()]];
+			if (item.zIndex != sprite.zIndex) {
+				item.zIndex = sprite.zIndex;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	// The items are almost sorted when only a few zIndex values changed, insertion sort is close to linear then
+	void ResortRenderItems() {
+		for (size_t i = 1; i < renderItems.size(); i++) {
+			RenderItem item = renderItems[i];
+			size_t j = i;
+			while (j > 0 && renderItems[j - 1].zIndex > item.zIndex) {
+				renderItems[j] = renderItems[j - 1];
+				j--;
+			}
+			renderItems[j] = item;
+		}
+	}
+
+	void UpdateRenderOrder(Registry& registry) {
+		// Change ticks are only tracked with pool storage, sort everything every frame otherwise
+		const bool tracksChanges = registry.GetStorageMode() == StorageMode::Pools;
+
+		if (!hasSorted || !tracksChanges || sortedMembershipVersion != GetMembershipVersion()) {
+			RebuildRenderItems();
+		} else if (UpdateChangedSortKeys(registry)) {
+			ResortRenderItems();
+		} else {
+			return;
+		}
+
+		for (int i = 0; i < static_cast<int>(renderItems.size()); i++) {
+			const auto entityId = renderItems[i].entity.GetId();
+			if (entityId >= static_cast<int>(entityIdToRenderItem.size())) {
+				entityIdToRenderItem.resize(entityId + 1, -1);
+			}
+			entityIdToRenderItem[entityId] = i;
+		}
+
+		sortedMembershipVersion = GetMembershipVersion();
+		hasSorted = true;
+	}
 public:
 	RenderSystem() {
 		RequireComponent<TransformComponent>();
 		RequireComponent<SpriteComponent>();
+		ReadsComponent<TransformComponent>();
+		ReadsComponent<SpriteComponent>();
+		ReadsComponent<PreviousTransformComponent>();
 	}
 
-	void Render(SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore) {
-		auto entities = GetSystemEntities();
-		// Sort the entities by order of z index here, in every frame
-		// this might not be good enough
-		std::sort(entities.begin(), entities.end(), [](Entity a, Entity b) {
-			return a.GetComponent<SpriteComponent>().zIndex < b.GetComponent<SpriteComponent>().zIndex;
-		});
-		for (auto entity : entities) {
-			const auto transform = entity.GetComponent<TransformComponent>();
-			const auto sprite = entity.GetComponent<SpriteComponent>();
-			
-			//SDL_SetRenderDrawColor(renderer, sprite.color.r, sprite.color.g, sprite.color.b, sprite.color.a);
-			
+	// Sprites whose zIndex changes at runtime have to be written through GetMutableComponent
+	// so the render order picks the change up.
+	// alpha is how far the frame is between the last two simulation steps (0 = the previous step, 1 = the last one),
+	// entities with a PreviousTransformComponent are drawn that far between their two transforms.
+	// Runs with the simulation, the snapshot is drawn later by Submit without touching the registry
+	void BuildSnapshot(Registry& registry, AssetStore& assetStore, double alpha, RenderSnapshot& snapshot) {
+		PROFILE_SCOPE("RenderSystem::BuildSnapshot");
 
-			// set the src rect
-			SDL_Rect srcRect = {
-				0,
-				0,
-				
-			};
+		UpdateRenderOrder(registry);
+		lastRenderTick = registry.GetCurrentTick();
+
+		snapshot.commands.clear();
+		snapshot.commands.reserve(renderItems.size());
+
+		// Neighbouring sprites mostly share a texture (the tiles all do), saves a map lookup for each of them
+		const std::string* lastAssetId = nullptr;
+		SDL_Texture* lastTexture = nullptr;
+
+		for (const auto& item : renderItems) {
+			const auto& transform = item.entity.GetComponent<TransformComponent>();
+			const auto& sprite = item.entity.GetComponent<SpriteComponent>();
+
+			glm::vec2 position = transform.position;
+			glm::vec2 scale = transform.scale;
+			double rotation = transform.rotation;
+			if (item.entity.HasComponent<PreviousTransformComponent>()) {
+				const auto& previous = item.entity.GetComponent<PreviousTransformComponent>();
+				const float t = static_cast<float>(alpha);
+				position = glm::mix(previous.position, transform.position, t);
+				scale = glm::mix(previous.scale, transform.scale, t);
+				rotation = previous.rotation + (transform.rotation - previous.rotation) * alpha;
+			}
+
+			if (!lastAssetId || *lastAssetId != sprite.assetId) {
+				lastAssetId = &sprite.assetId;
+				lastTexture = assetStore.GetTexture(sprite.assetId);
+			}
+
+			//SDL_SetRenderDrawColor(renderer, sprite.color.r, sprite.color.g, sprite.color.b, sprite.color.a);
 
 			// set the destination rect with the x, y position to be rendered
 			SDL_Rect destRect = {
-				static_cast<int>(transform.position.x),
-				static_cast<int>(transform.position.y),
-				static_cast<int>(sprite.width * transform.scale.x),
-				static_cast<int>(sprite.height * transform.scale.y),
+				static_cast<int>(position.x),
+				static_cast<int>(position.y),
+				static_cast<int>(sprite.width * scale.x),
+				static_cast<int>(sprite.height * scale.y),
 			};
 
+			snapshot.commands.push_back({ lastTexture, sprite.srcRect, destRect, rotation, item.zIndex });
+		}
+	}
+
+	// Draws a snapshot, the only part of rendering that has to run on the thread that owns the renderer
+	static void Submit(const RenderSnapshot& snapshot, SDL_Renderer* renderer) {
+		PROFILE_SCOPE("RenderSystem::Submit");
+
+		for (const auto& command : snapshot.commands) {
 			SDL_RenderCopyEx(renderer,
-				assetStore->GetTexture(sprite.assetId), 
-				&(sprite.srcRect),
-				&destRect,
-				transform.rotation,
+				command.texture,
+				&command.srcRect,
+				&command.destRect,
+				command.rotation,
 				NULL,
 				SDL_FLIP_NONE);
 
@@ -57,4 +170,4 @@ public:
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
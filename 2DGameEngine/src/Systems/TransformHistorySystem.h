@@ -0,0 +1,37 @@
+#ifndef TRANSFORMHISTORYSYSTEM_H
+#define TRANSFORMHISTORYSYSTEM_H
+
+#include "../ECS/ECS.h"
+#include "../Components/TransformComponent.h"
+#include "../Components/PreviousTransformComponent.h"
+#include "../Profiler/Profiler.h"
+
+// Copies every TransformComponent into its PreviousTransformComponent.
+// Runs at the start of each simulation step, before anything moves
+class TransformHistorySystem : public System {
+public:
+	TransformHistorySystem() {
+		RequireComponent<TransformComponent>();
+		RequireComponent<PreviousTransformComponent>();
+		ReadsComponent<TransformComponent>();
+		WritesComponent<PreviousTransformComponent>();
+	}
+
+	// Number of work items Update can be split into
+	int GetWorkSize(const Registry& registry) const {
+		return registry.EachSize<TransformComponent, PreviousTransformComponent>();
+	}
+
+	// Only updates work items [first, last), disjoint ranges can run on different threads
+	void Update(Registry& registry, int first, int last) {
+		PROFILE_SCOPE("TransformHistorySystem");
+
+		registry.EachInRange<TransformComponent, PreviousTransformComponent>(first, last, [](Entity, TransformComponent& transform, PreviousTransformComponent& previous) {
+			previous.position = transform.position;
+			previous.scale = transform.scale;
+			previous.rotation = transform.rotation;
+		});
+	}
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "StatsExporter.h"
+#include "../Logger/Logger.h"
+#include "../Profiler/Profiler.h"
+
+template <size_t N>
+static void CopyName(char (&destination)[N], const std::string& name) {
+	const size_t length = std::min(name.size(), N - 1);
+	std::memcpy(destination, name.data(), length);
+	destination[length] = '\0';
+}
+
+static uint64_t TicksToNanoseconds(uint64_t ticks) {
+	return static_cast<uint64_t>(Profiler::TicksToMicroseconds(ticks) * 1000.0);
+}
+
+bool StatsExporter::Open(const std::string& name) {
+	if (!page.Create(name)) {
+		LOG_ERR(LogCategory::General, "Could not create the stats page {}", name);
+		return false;
+	}
+
+	LOG_INFO(LogCategory::General, "Publishing engine stats to shared memory {}", name);
+	lastPublishTicks = Profiler::Now();
+	lastFrameEndTicks = lastPublishTicks;
+	return true;
+}
+
+void StatsExporter::EndFrame(uint64_t frameCount, const Registry& registry, const SystemScheduler& systemScheduler, const AssetStore& assetStore) {
+	if (!page.IsOpen()) {
+		return;
+	}
+
+	const uint64_t now = Profiler::Now();
+	const uint64_t frameTicks = now - lastFrameEndTicks;
+	lastFrameEndTicks = now;
+	frameTicksTotal += frameTicks;
+	frameTicksMax = std::max(frameTicksMax, frameTicks);
+	numFrames++;
+
+	if (Profiler::TicksToMicroseconds(now - lastPublishTicks) < PUBLISH_MILLISECONDS * 1000.0) {
+		return;
+	}
+
+	Publish(frameCount, registry, systemScheduler, assetStore);
+
+	lastPublishTicks = now;
+	frameTicksTotal = 0;
+	frameTicksMax = 0;
+	updateTicksTotal = 0;
+	renderTicksTotal = 0;
+	numFrames = 0;
+}
+
+void StatsExporter::Publish(uint64_t frameCount, const Registry& registry, const SystemScheduler& systemScheduler, const AssetStore& assetStore) {
+	PROFILE_SCOPE("StatsExporter::Publish");
+
+	data.timestampNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	data.frameCount = frameCount;
+
+	data.numFrames = numFrames;
+	data.frameNanosecondsAverage = TicksToNanoseconds(frameTicksTotal / numFrames);
+	data.frameNanosecondsMax = TicksToNanoseconds(frameTicksMax);
+	data.updateNanosecondsAverage = TicksToNanoseconds(updateTicksTotal / numFrames);
+	data.renderNanosecondsAverage = TicksToNanoseconds(renderTicksTotal / numFrames);
+
+	data.numEntities = static_cast<uint32_t>(registry.GetNumEntities());
+	data.numEntityIds = static_cast<uint32_t>(registry.GetNumEntityIds());
+	data.numTextures = static_cast<uint32_t>(assetStore.GetNumTextures());
+	data.textureBytes = assetStore.GetTextureMemory();
+
+	data.logDropped = Logger::GetNumDropped();
+	data.logStalls = Logger::GetNumStalls();
+
+	const auto& timings = systemScheduler.GetLastTimings();
+	const auto& systems = registry.GetSystems();
+	data.numSystems = static_cast<uint32_t>(std::min<size_t>(systems.size(), StatsPageData::MAX_SYSTEMS));
+	for (uint32_t i = 0; i < data.numSystems; i++) {
+		const System* system = systems[i];
+		StatsPageSystem& systemStats = data.systems[i];
+		CopyName(systemStats.name, system->GetName());
+		systemStats.numEntities = static_cast<uint32_t>(system->GetSystemEntities().size());
+
+		// Systems the scheduler didn't run last frame (RenderSystem) report zero, their time is in the render average
+		auto timing = std::find_if(timings.begin(), timings.end(), [system](const SystemScheduler::SystemTiming& timing) {
+			return timing.system == system;
+		});
+		const bool isScheduled = timing != timings.end();
+		systemStats.wallNanoseconds = isScheduled ? TicksToNanoseconds(timing->wallTicks) : 0;
+		systemStats.busyNanoseconds = isScheduled ? TicksToNanoseconds(timing->busyTicks) : 0;
+		systemStats.numRanges = isScheduled ? static_cast<uint32_t>(timing->numRanges) : 0;
+	}
+
+	registry.GetStorageStats(storageStats);
+	data.numPools = static_cast<uint32_t>(std::min<size_t>(storageStats.size(), StatsPageData::MAX_POOLS));
+	for (uint32_t i = 0; i < data.numPools; i++) {
+		const StorageStats& stats = storageStats[i];
+		StatsPagePool& pool = data.pools[i];
+		CopyName(pool.name, stats.name);
+		pool.size = static_cast<uint32_t>(stats.size);
+		pool.capacity = static_cast<uint32_t>(stats.capacity);
+		pool.bytes = static_cast<uint64_t>(stats.capacity) * stats.itemSize;
+	}
+
+	MemoryTracker::GetStats(memoryStats);
+	data.numMemoryTags = static_cast<uint32_t>(std::min<size_t>(memoryStats.size(), StatsPageData::MAX_MEMORY_TAGS));
+	for (uint32_t i = 0; i < data.numMemoryTags; i++) {
+		StatsPageMemory& memory = data.memory[i];
+		CopyName(memory.name, memoryStats[i].name);
+		memory.liveBytes = memoryStats[i].liveBytes;
+		memory.peakBytes = memoryStats[i].peakBytes;
+	}
+
+	page.Publish(data);
+}
@@ -0,0 +1,51 @@
+#ifndef STATSEXPORTER_H
+#define STATSEXPORTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "StatsPage.h"
+#include "../ECS/ECS.h"
+#include "../ECS/SystemScheduler.h"
+#include "../AssetStore/AssetStore.h"
+#include "../Memory/MemoryTracker.h"
+
+// Fills the StatsPage from the engine.
+// Frame times are accumulated every frame (a few adds), the rest of the engine is only walked when
+// a publish is due, every PUBLISH_MILLISECONDS. Does nothing until Open succeeds.
+class StatsExporter {
+public:
+	static constexpr int PUBLISH_MILLISECONDS = 100;
+
+private:
+	StatsPage page;
+	StatsPageData data = {};
+	uint64_t lastPublishTicks = 0;
+
+	// Profiler::Now ticks since the last publish
+	uint64_t lastFrameEndTicks = 0;
+	uint64_t frameTicksTotal = 0;
+	uint64_t frameTicksMax = 0;
+	uint64_t updateTicksTotal = 0;
+	uint64_t renderTicksTotal = 0;
+	uint32_t numFrames = 0;
+
+	// Kept between publishes so gathering doesn't allocate once they are big enough
+	std::vector<StorageStats> storageStats;
+	std::vector<MemoryStats> memoryStats;
+
+	void Publish(uint64_t frameCount, const Registry& registry, const SystemScheduler& systemScheduler, const AssetStore& assetStore);
+public:
+	// Creates the shared memory page name, see StatsPage
+	bool Open(const std::string& name);
+	void Close() { page.Close(); }
+	bool IsOpen() const { return page.IsOpen(); }
+
+	void RecordUpdate(uint64_t ticks) { updateTicksTotal += ticks; }
+	void RecordRender(uint64_t ticks) { renderTicksTotal += ticks; }
+	// Once per frame, the frame time is the time since the last call.
+	// Publishes when PUBLISH_MILLISECONDS have passed since the last publish
+	void EndFrame(uint64_t frameCount, const Registry& registry, const SystemScheduler& systemScheduler, const AssetStore& assetStore);
+};
+
+#endif
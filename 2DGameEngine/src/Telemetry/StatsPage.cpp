@@ -0,0 +1,168 @@
+#include <cstring>
+#include <thread>
+#include "StatsPage.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr char StatsPage::MAGIC[8];
+
+// Tries a reader makes before giving up on a writer that keeps publishing
+static constexpr int READ_ATTEMPTS = 64;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "The sequence is shared between processes and has to be a plain lock free word");
+
+StatsPage::~StatsPage() {
+	Close();
+}
+
+bool StatsPage::Create(const std::string& name) {
+	Close();
+	if (!Map(name, true)) {
+		return false;
+	}
+
+	isWriter = true;
+	std::memset(&view->data, 0, sizeof(view->data));
+	std::memcpy(view->header.magic, MAGIC, sizeof(MAGIC));
+	view->header.version = VERSION;
+	view->header.size = sizeof(Layout);
+#ifdef _WIN32
+	view->header.processId = static_cast<int64_t>(GetCurrentProcessId());
+#else
+	view->header.processId = static_cast<int64_t>(getpid());
+#endif
+	view->header.sequence.store(0, std::memory_order_release);
+	return true;
+}
+
+bool StatsPage::Attach(const std::string& name) {
+	Close();
+	if (!Map(name, false)) {
+		return false;
+	}
+
+	if (std::memcmp(view->header.magic, MAGIC, sizeof(MAGIC)) != 0 || view->header.version != VERSION || view->header.size != sizeof(Layout)) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool StatsPage::Map(const std::string& name, bool create) {
+#ifdef _WIN32
+	const std::string objectName = "Local\\" + name;
+	HANDLE mapping;
+	if (create) {
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(sizeof(Layout)), objectName.c_str());
+	} else {
+		mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, objectName.c_str());
+	}
+	if (!mapping) {
+		return false;
+	}
+
+	void* mappedView = MapViewOfFile(mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, sizeof(Layout));
+	if (!mappedView) {
+		CloseHandle(mapping);
+		return false;
+	}
+
+	mappingHandle = mapping;
+#else
+	const std::string objectName = "/" + name;
+	const int descriptor = create ? shm_open(objectName.c_str(), O_RDWR | O_CREAT, 0644) : shm_open(objectName.c_str(), O_RDONLY, 0);
+	if (descriptor < 0) {
+		return false;
+	}
+
+	if (create && ftruncate(descriptor, static_cast<off_t>(sizeof(Layout))) != 0) {
+		close(descriptor);
+		return false;
+	}
+
+	// A page left behind by a game that crashed can be smaller than this build's layout
+	struct stat info;
+	if (!create && (fstat(descriptor, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Layout))) {
+		close(descriptor);
+		return false;
+	}
+
+	void* mappedView = mmap(nullptr, sizeof(Layout), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, descriptor, 0);
+	// The mapping keeps the segment alive on its own
+	close(descriptor);
+	if (mappedView == MAP_FAILED) {
+		return false;
+	}
+#endif
+
+	view = static_cast<Layout*>(mappedView);
+	segmentName = name;
+	return true;
+}
+
+void StatsPage::Close() {
+	if (!view) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+	CloseHandle(static_cast<HANDLE>(mappingHandle));
+	mappingHandle = nullptr;
+#else
+	munmap(view, sizeof(Layout));
+	if (isWriter) {
+		shm_unlink(("/" + segmentName).c_str());
+	}
+#endif
+
+	view = nullptr;
+	isWriter = false;
+	segmentName.clear();
+}
+
+void StatsPage::Publish(const StatsPageData& data) {
+	if (!view || !isWriter) {
+		return;
+	}
+
+	// Odd while writing, the fence keeps the data writes from moving above it
+	const uint32_t sequence = view->header.sequence.load(std::memory_order_relaxed);
+	view->header.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::memcpy(&view->data, &data, sizeof(data));
+
+	view->header.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool StatsPage::Read(StatsPageData& data) const {
+	if (!view) {
+		return false;
+	}
+
+	for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+		const uint32_t before = view->header.sequence.load(std::memory_order_acquire);
+		if (before & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::memcpy(&data, &view->data, sizeof(data));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (view->header.sequence.load(std::memory_order_relaxed) == before) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,127 @@
+#ifndef STATSPAGE_H
+#define STATSPAGE_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+struct StatsPageSystem {
+	char name[48];
+	// SystemScheduler::SystemTiming of the last frame
+	uint64_t wallNanoseconds;
+	uint64_t busyNanoseconds;
+	uint32_t numRanges;
+	uint32_t numEntities;
+};
+
+struct StatsPagePool {
+	char name[48];
+	uint32_t size;
+	uint32_t capacity;
+	uint64_t bytes;
+};
+
+struct StatsPageMemory {
+	char name[48];
+	int64_t liveBytes;
+	int64_t peakBytes;
+};
+
+// Everything the game publishes. Plain data only, the layout is what readers in other processes see
+struct StatsPageData {
+	static constexpr int MAX_SYSTEMS = 32;
+	static constexpr int MAX_POOLS = 64;
+	static constexpr int MAX_MEMORY_TAGS = 32;
+
+	// system_clock nanoseconds since the epoch of the publish, a reader can tell a hung game from this
+	int64_t timestampNanoseconds;
+	uint64_t frameCount;
+
+	// Over the frames since the previous publish
+	uint32_t numFrames;
+	uint32_t reserved;
+	uint64_t frameNanosecondsAverage;
+	uint64_t frameNanosecondsMax;
+	uint64_t updateNanosecondsAverage;
+	uint64_t renderNanosecondsAverage;
+
+	uint32_t numEntities;
+	uint32_t numEntityIds;
+	uint32_t numTextures;
+	uint32_t reserved2;
+	uint64_t textureBytes;
+
+	// Since startup, see Logger::GetNumDropped / GetNumStalls
+	uint64_t logDropped;
+	uint64_t logStalls;
+
+	uint32_t numSystems;
+	uint32_t numPools;
+	uint32_t numMemoryTags;
+	uint32_t reserved3;
+	StatsPageSystem systems[MAX_SYSTEMS];
+	StatsPagePool pools[MAX_POOLS];
+	StatsPageMemory memory[MAX_MEMORY_TAGS];
+};
+
+// Engine counters in a named shared memory segment, so a dashboard or monitoring agent on the same machine can
+// sample a running game without going through its logs and without the game waiting on it.
+// The game creates the page and publishes into it, readers attach by name and copy it out.
+// Publishing is a seqlock: the sequence is odd while the data is being written, a reader whose copy
+// started and ended on the same even sequence has a consistent snapshot, otherwise it tries again.
+// Neither side ever blocks the other.
+//
+// The segment is "/<name>" under POSIX shm_open (/dev/shm/<name> on Linux) and "Local\<name>" on Windows.
+class StatsPage {
+public:
+	static constexpr char MAGIC[8] = { '2', 'D', 'G', 'E', 'S', 'T', 'S', '\0' };
+	static constexpr uint32_t VERSION = 1;
+	static constexpr const char* DEFAULT_NAME = "2DGameEngineStats";
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		// sizeof(Layout) of the writer, readers refuse pages of another size
+		uint32_t size;
+		int64_t processId;
+		std::atomic<uint32_t> sequence;
+		uint32_t reserved;
+	};
+
+	struct Layout {
+		Header header;
+		StatsPageData data;
+	};
+
+private:
+	Layout* view = nullptr;
+	bool isWriter = false;
+	std::string segmentName;
+
+#ifdef _WIN32
+	void* mappingHandle = nullptr;
+#endif
+
+	bool Map(const std::string& name, bool create);
+public:
+	StatsPage() = default;
+	~StatsPage();
+	StatsPage(const StatsPage&) = delete;
+	StatsPage& operator =(const StatsPage&) = delete;
+
+	// Game side: creates (or takes over) the segment name
+	bool Create(const std::string& name = DEFAULT_NAME);
+	// Reader side: maps an existing segment read only, false if there is none or it isn't a stats page
+	bool Attach(const std::string& name = DEFAULT_NAME);
+	// The writer also removes the segment
+	void Close();
+	bool IsOpen() const { return view != nullptr; }
+
+	void Publish(const StatsPageData& data);
+	// False when the writer was in the middle of a publish for every try
+	bool Read(StatsPageData& data) const;
+	int64_t GetProcessId() const { return view ? view->header.processId : 0; }
+};
+
+#endif
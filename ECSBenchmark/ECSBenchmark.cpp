@@ -0,0 +1,273 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include "../2DGameEngine/src/ECS/ECS.h"
+#include "../2DGameEngine/src/Logger/Logger.h"
+
+// Microbenchmarks for the Registry, no window and no SDL.
+// Every pass creates a fresh registry and times each phase of an entity's life:
+//   Create   CreateEntity + the Update that matches the new entities with the systems
+//   Add      AddComponent<Position> and AddComponent<Velocity> (two ops per entity)
+//   Get      GetComponent<Position>
+//   Iterate  Each<Position, Velocity>, the way the systems walk their components
+//   Remove   RemoveComponent<Velocity> + Update
+//   Destroy  KillEntity + Update
+// for both storage modes. Each repetition keeps the fastest of several passes, the result is the
+// median of the repetitions so one disturbed repetition doesn't move it.
+//
+// Usage: ECSBenchmark [--baseline <file>] [--write-baseline <file>] [--threshold <percent>] [--repetitions <n>] [--max-entities <n>]
+// With a baseline the run fails (exit code 1) when an operation got slower by more than the threshold.
+// Baselines are absolute timings and only mean something on the machine and build that recorded them,
+// so none is checked in: record one with --write-baseline on the reference machine (Release build of
+// this project) and compare against it there.
+
+struct Position {
+	float x = 0.0f;
+	float y = 0.0f;
+};
+
+struct Velocity {
+	float x = 0.0f;
+	float y = 0.0f;
+};
+
+class BenchmarkSystem : public System {
+public:
+	BenchmarkSystem() {
+		RequireComponent<Position>();
+		RequireComponent<Velocity>();
+	}
+};
+
+struct BenchmarkResult {
+	std::string name;
+	double nanosecondsPerOp;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from throwing the Get and Iterate loops away
+static volatile float sink = 0.0f;
+
+static double NanosecondsSince(Clock::time_point begin) {
+	return std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+}
+
+static const char* GetModeName(StorageMode mode) {
+	return mode == StorageMode::Pools ? "Pools" : "Archetypes";
+}
+
+// One pass over every phase, adds the ns/op of each phase to best when it beats what is there
+static void RunPass(StorageMode mode, int numEntities, std::map<std::string, double>& best) {
+	Registry registry(mode);
+	registry.AddSystem<BenchmarkSystem>();
+
+	std::vector<Entity> entities;
+	entities.reserve(numEntities);
+
+	auto record = [&best, mode, numEntities](const char* phase, double nanoseconds, int numOps) {
+		const std::string name = std::string(GetModeName(mode)) + "/" + phase + "/" + std::to_string(numEntities);
+		const double nanosecondsPerOp = nanoseconds / numOps;
+		auto result = best.find(name);
+		if (result == best.end() || nanosecondsPerOp < result->second) {
+			best[name] = nanosecondsPerOp;
+		}
+	};
+
+	auto begin = Clock::now();
+	for (int i = 0; i < numEntities; i++) {
+		entities.push_back(registry.CreateEntity());
+	}
+	registry.Update();
+	record("Create", NanosecondsSince(begin), numEntities);
+
+	begin = Clock::now();
+	for (int i = 0; i < numEntities; i++) {
+		registry.AddComponent<Position>(entities[i], Position{ static_cast<float>(i), 0.0f });
+		registry.AddComponent<Velocity>(entities[i], Velocity{ 1.0f, 2.0f });
+	}
+	registry.Update();
+	record("Add", NanosecondsSince(begin), numEntities * 2);
+
+	begin = Clock::now();
+	float sum = 0.0f;
+	for (int i = 0; i < numEntities; i++) {
+		sum += registry.GetComponent<Position>(entities[i]).x;
+	}
+	record("Get", NanosecondsSince(begin), numEntities);
+	sink = sum;
+
+	begin = Clock::now();
+	registry.Each<Position, Velocity>([](Entity, Position& position, Velocity& velocity) {
+		position.x += velocity.x * 0.016f;
+		position.y += velocity.y * 0.016f;
+	});
+	record("Iterate", NanosecondsSince(begin), numEntities);
+	sink = registry.GetComponent<Position>(entities[0]).x;
+
+	begin = Clock::now();
+	for (int i = 0; i < numEntities; i++) {
+		registry.RemoveComponent<Velocity>(entities[i]);
+	}
+	registry.Update();
+	record("Remove", NanosecondsSince(begin), numEntities);
+
+	begin = Clock::now();
+	for (int i = 0; i < numEntities; i++) {
+		registry.KillEntity(entities[i]);
+	}
+	registry.Update();
+	record("Destroy", NanosecondsSince(begin), numEntities);
+}
+
+static double GetMedian(std::vector<double> values) {
+	std::sort(values.begin(), values.end());
+	const size_t middle = values.size() / 2;
+	return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+// Reads the flat {"name": nsPerOp, ...} object WriteBaseline writes
+static bool ReadBaseline(const std::string& path, std::map<std::string, double>& baseline) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string json = contents.str();
+
+	size_t position = 0;
+	while ((position = json.find('"', position)) != std::string::npos) {
+		const size_t nameEnd = json.find('"', position + 1);
+		const size_t colon = nameEnd == std::string::npos ? std::string::npos : json.find(':', nameEnd);
+		if (colon == std::string::npos) {
+			break;
+		}
+
+		const std::string name = json.substr(position + 1, nameEnd - position - 1);
+		char* numberEnd = nullptr;
+		const double value = std::strtod(json.c_str() + colon + 1, &numberEnd);
+		if (numberEnd != json.c_str() + colon + 1) {
+			baseline[name] = value;
+		}
+		position = numberEnd ? static_cast<size_t>(numberEnd - json.c_str()) : colon + 1;
+	}
+
+	return true;
+}
+
+static bool WriteBaseline(const std::string& path, const std::vector<BenchmarkResult>& results) {
+	std::ofstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	char number[32];
+	file << "{\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		std::snprintf(number, sizeof(number), "%.3f", results[i].nanosecondsPerOp);
+		file << "\t\"" << results[i].name << "\": " << number << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	file << "}\n";
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	std::string baselinePath;
+	std::string writeBaselinePath;
+	double thresholdPercent = 10.0;
+	int numRepetitions = 5;
+	int maxEntities = 1000000;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			baselinePath = argv[++i];
+		} else if (std::strcmp(argv[i], "--write-baseline") == 0 && i + 1 < argc) {
+			writeBaselinePath = argv[++i];
+		} else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+			thresholdPercent = std::atof(argv[++i]);
+		} else if (std::strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+			numRepetitions = std::max(std::atoi(argv[++i]), 1);
+		} else if (std::strcmp(argv[i], "--max-entities") == 0 && i + 1 < argc) {
+			maxEntities = std::atoi(argv[++i]);
+		} else {
+			std::cerr << "Usage: ECSBenchmark [--baseline <file>] [--write-baseline <file>] [--threshold <percent>] [--repetitions <n>] [--max-entities <n>]" << std::endl;
+			return 1;
+		}
+	}
+
+	// The ECS logs every entity it creates at debug level, that would be all we measure
+	for (int category = 0; category < static_cast<int>(LogCategory::Count); category++) {
+		Logger::SetLevel(static_cast<LogCategory>(category), LogLevel::Warning);
+	}
+
+	std::map<std::string, double> baseline;
+	if (!baselinePath.empty() && !ReadBaseline(baselinePath, baseline)) {
+		std::cerr << "Could not read baseline " << baselinePath << std::endl;
+		return 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	int numRegressions = 0;
+
+	std::printf("%-30s %12s %12s %12s %9s\n", "Benchmark", "ns/op", "Mops/s", "baseline", "change");
+
+	for (StorageMode mode : { StorageMode::Pools, StorageMode::Archetypes }) {
+		for (int numEntities = 1000; numEntities <= maxEntities; numEntities *= 10) {
+			// Small sizes finish quickly and are noisy, give them more passes
+			const int numPasses = std::min(std::max(1000000 / numEntities, 3), 50);
+
+			std::map<std::string, std::vector<double>> repetitions;
+			for (int repetition = 0; repetition < numRepetitions; repetition++) {
+				std::map<std::string, double> best;
+				for (int pass = 0; pass < numPasses; pass++) {
+					RunPass(mode, numEntities, best);
+				}
+				for (const auto& result : best) {
+					repetitions[result.first].push_back(result.second);
+				}
+			}
+
+			for (const char* phase : { "Create", "Add", "Get", "Iterate", "Remove", "Destroy" }) {
+				const std::string name = std::string(GetModeName(mode)) + "/" + phase + "/" + std::to_string(numEntities);
+				const double nanosecondsPerOp = GetMedian(repetitions[name]);
+				results.push_back({ name, nanosecondsPerOp });
+
+				std::printf("%-30s %12.2f %12.2f", name.c_str(), nanosecondsPerOp, 1000.0 / nanosecondsPerOp);
+
+				auto baselineResult = baseline.find(name);
+				if (baselineResult != baseline.end() && baselineResult->second > 0.0) {
+					const double change = (nanosecondsPerOp / baselineResult->second - 1.0) * 100.0;
+					const bool isRegression = change > thresholdPercent;
+					numRegressions += isRegression ? 1 : 0;
+					std::printf(" %12.2f %+8.1f%%%s", baselineResult->second, change, isRegression ? "  REGRESSION" : "");
+				}
+				std::printf("\n");
+			}
+		}
+	}
+
+	if (!writeBaselinePath.empty()) {
+		if (!WriteBaseline(writeBaselinePath, results)) {
+			std::cerr << "Could not write baseline " << writeBaselinePath << std::endl;
+			return 1;
+		}
+		std::printf("Baseline written to %s\n", writeBaselinePath.c_str());
+	}
+
+	if (numRegressions > 0) {
+		std::printf("%d benchmarks regressed by more than %.1f%%\n", numRegressions, thresholdPercent);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include <cstdio>
+#include "../2DGameEngine/src/EventBus/EventBus.h"
+
+// Checks for the EventBus, in particular subscribers that publish, subscribe and unsubscribe
+// while a batch is being delivered to them. No window and no SDL.
+// Prints every failed check and exits with 1 if there was one.
+
+struct Collision {
+	int first;
+	int second;
+};
+
+struct Damage {
+	int amount;
+};
+
+// Splits a chain of hits: every hit above 1 publishes another hit of half the amount
+struct Hit {
+	int amount;
+};
+
+static int numFailures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			numFailures++; \
+		} \
+	} while (0)
+
+class DamageSystem {
+public:
+	EventBus* eventBus = nullptr;
+	int numCollisionBatches = 0;
+	int totalDamage = 0;
+
+	void OnCollision(Span<const Collision> collisions) {
+		numCollisionBatches++;
+		for (const auto& collision : collisions) {
+			eventBus->Publish<Damage>(collision.first + collision.second);
+		}
+	}
+
+	void OnDamage(Span<const Damage> damages) {
+		for (const auto& damage : damages) {
+			totalDamage += damage.amount;
+		}
+	}
+};
+
+class HitSplitter {
+public:
+	EventBus* eventBus = nullptr;
+	std::vector<int> received;
+	int numBatches = 0;
+
+	void OnHit(Span<const Hit> hits) {
+		numBatches++;
+		for (const auto& hit : hits) {
+			received.push_back(hit.amount);
+			// Same type as the batch being delivered, enough of them to make the queue grow
+			for (int i = 0; hit.amount > 1 && i < 100; i++) {
+				eventBus->Publish<Hit>(hit.amount / 2);
+			}
+		}
+	}
+};
+
+class Counter {
+public:
+	EventBus* eventBus = nullptr;
+	Counter* toUnsubscribe = nullptr;
+	Counter* toSubscribe = nullptr;
+	int numEvents = 0;
+
+	void OnDamage(Span<const Damage> damages) {
+		numEvents += static_cast<int>(damages.size());
+		if (toUnsubscribe) {
+			eventBus->Unsubscribe(toUnsubscribe);
+			toUnsubscribe = nullptr;
+		}
+		if (toSubscribe) {
+			eventBus->Subscribe<Damage, &Counter::OnDamage>(toSubscribe);
+			toSubscribe = nullptr;
+		}
+	}
+};
+
+static void TestPublishOtherTypeFromSubscriber() {
+	EventBus eventBus;
+	DamageSystem damageSystem;
+	damageSystem.eventBus = &eventBus;
+	// Damage subscribed first so its queue is visited before the collisions that publish into it
+	eventBus.Subscribe<Damage, &DamageSystem::OnDamage>(&damageSystem);
+	eventBus.Subscribe<Collision, &DamageSystem::OnCollision>(&damageSystem);
+
+	eventBus.Publish<Collision>(1, 2);
+	eventBus.Publish<Collision>(3, 4);
+	eventBus.Dispatch();
+
+	CHECK(damageSystem.numCollisionBatches == 1);
+	CHECK(damageSystem.totalDamage == 10);
+	CHECK(eventBus.GetEvents<Damage>().size() == 2);
+
+	eventBus.Clear();
+	CHECK(eventBus.GetEvents<Collision>().empty());
+	CHECK(eventBus.GetEvents<Damage>().empty());
+}
+
+static void TestPublishSameTypeFromSubscriber() {
+	EventBus eventBus;
+	HitSplitter splitter;
+	splitter.eventBus = &eventBus;
+	eventBus.Subscribe<Hit, &HitSplitter::OnHit>(&splitter);
+
+	eventBus.Publish<Hit>(4);
+	eventBus.Dispatch();
+
+	// 4, then 100 hits of 2, then 100 * 100 hits of 1, each generation in a batch of its own
+	CHECK(splitter.numBatches == 3);
+	CHECK(splitter.received.size() == 1 + 100 + 100 * 100);
+	CHECK(splitter.received.front() == 4);
+	CHECK(splitter.received[1] == 2 && splitter.received[100] == 2);
+	CHECK(splitter.received.back() == 1);
+	CHECK(eventBus.GetEvents<Hit>().size() == 1 + 100 + 100 * 100);
+}
+
+static void TestSubscribeAndUnsubscribeFromSubscriber() {
+	EventBus eventBus;
+	Counter first;
+	Counter second;
+	Counter third;
+	first.eventBus = &eventBus;
+	first.toUnsubscribe = &second;
+	first.toSubscribe = &third;
+	eventBus.Subscribe<Damage, &Counter::OnDamage>(&first);
+	eventBus.Subscribe<Damage, &Counter::OnDamage>(&second);
+
+	eventBus.Publish<Damage>(1);
+	eventBus.Dispatch();
+
+	// second was removed before its turn, third was added during the batch and waits for the next one
+	CHECK(first.numEvents == 1);
+	CHECK(second.numEvents == 0);
+	CHECK(third.numEvents == 0);
+
+	eventBus.Publish<Damage>(2);
+	eventBus.Dispatch();
+
+	CHECK(first.numEvents == 2);
+	CHECK(second.numEvents == 0);
+	CHECK(third.numEvents == 1);
+}
+
+static void TestDispatchOnlyDeliversNewEvents() {
+	EventBus eventBus;
+	Counter counter;
+	eventBus.Subscribe<Damage, &Counter::OnDamage>(&counter);
+
+	eventBus.Publish<Damage>(1);
+	eventBus.Dispatch();
+	eventBus.Publish<Damage>(2);
+	eventBus.Publish<Damage>(3);
+	eventBus.Dispatch();
+	eventBus.Dispatch();
+
+	CHECK(counter.numEvents == 3);
+	CHECK(eventBus.GetEvents<Damage>().size() == 3);
+
+	eventBus.Unsubscribe(&counter);
+	eventBus.Publish<Damage>(4);
+	eventBus.Dispatch();
+	CHECK(counter.numEvents == 3);
+}
+
+int main() {
+	TestPublishOtherTypeFromSubscriber();
+	TestPublishSameTypeFromSubscriber();
+	TestSubscribeAndUnsubscribeFromSubscriber();
+	TestDispatchOnlyDeliversNewEvents();
+
+	if (numFailures > 0) {
+		std::printf("%d checks failed\n", numFailures);
+		return 1;
+	}
+	std::printf("All event bus checks passed\n");
+	return 0;
+}
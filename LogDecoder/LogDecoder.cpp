@@ -0,0 +1,20 @@
+#include <iostream>
+#include <string>
+#include "../2DGameEngine/src/Logger/LogFile.h"
+
+// Turns a binary log written with Logger::OpenBinaryLog back into text
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cerr << "Usage: LogDecoder <log file>" << std::endl;
+		return 1;
+	}
+
+	std::string text;
+	if (!LogFile::Decode(argv[1], text)) {
+		std::cerr << argv[1] << " is not a readable log file" << std::endl;
+		return 1;
+	}
+
+	std::cout << text;
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include "../2DGameEngine/src/Telemetry/StatsPage.h"
+
+// Samples the stats page of a running game (started with --stats-page) and prints it.
+// Only reads the shared memory, the game never waits on it.
+//
+// Usage: StatsMonitor [--name <page>] [--interval <milliseconds>] [--once]
+
+static void Print(const StatsPageData& data, int64_t processId) {
+	const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	const double age = (now - data.timestampNanoseconds) / 1e6;
+
+	std::printf("Process %lld, frame %llu, published %.0f ms ago\n", static_cast<long long>(processId), static_cast<unsigned long long>(data.frameCount), age);
+	std::printf("  Frame avg %.3f ms, max %.3f ms over %u frames, update %.3f ms, render %.3f ms\n",
+		data.frameNanosecondsAverage / 1e6, data.frameNanosecondsMax / 1e6, data.numFrames,
+		data.updateNanosecondsAverage / 1e6, data.renderNanosecondsAverage / 1e6);
+	std::printf("  Entities %u (ids %u), textures %u (%.2f MB), log dropped %llu, log stalls %llu\n",
+		data.numEntities, data.numEntityIds, data.numTextures, data.textureBytes / (1024.0 * 1024.0),
+		static_cast<unsigned long long>(data.logDropped), static_cast<unsigned long long>(data.logStalls));
+
+	for (uint32_t i = 0; i < data.numSystems; i++) {
+		const StatsPageSystem& system = data.systems[i];
+		std::printf("  %-32s %8u entities %10.3f ms wall %10.3f ms busy %4u ranges\n",
+			system.name, system.numEntities, system.wallNanoseconds / 1e6, system.busyNanoseconds / 1e6, system.numRanges);
+	}
+	for (uint32_t i = 0; i < data.numPools; i++) {
+		const StatsPagePool& pool = data.pools[i];
+		std::printf("  %-32s %8u / %-8u %10.1f KB\n", pool.name, pool.size, pool.capacity, pool.bytes / 1024.0);
+	}
+	for (uint32_t i = 0; i < data.numMemoryTags; i++) {
+		const StatsPageMemory& memory = data.memory[i];
+		std::printf("  %-32s %10.1f KB live %10.1f KB peak\n", memory.name, memory.liveBytes / 1024.0, memory.peakBytes / 1024.0);
+	}
+	std::fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+	std::string name = StatsPage::DEFAULT_NAME;
+	int intervalMilliseconds = 1000;
+	bool isOnce = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+			name = argv[++i];
+		} else if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+			intervalMilliseconds = std::atoi(argv[++i]);
+		} else if (std::strcmp(argv[i], "--once") == 0) {
+			isOnce = true;
+		} else {
+			std::cerr << "Usage: StatsMonitor [--name <page>] [--interval <milliseconds>] [--once]" << std::endl;
+			return 1;
+		}
+	}
+
+	StatsPage page;
+	if (!page.Attach(name)) {
+		std::cerr << "No stats page " << name << ", is the game running with --stats-page?" << std::endl;
+		return 1;
+	}
+
+	// About 12 KB, keep it off the stack
+	static StatsPageData data;
+	while (true) {
+		if (page.Read(data)) {
+			Print(data, page.GetProcessId());
+		} else {
+			std::cerr << "The game kept publishing while the page was read, skipping this sample" << std::endl;
+		}
+
+		if (isOnce) {
+			return 0;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMilliseconds));
+	}
+}